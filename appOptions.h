@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+
+#include "headless.h"
+
+// Everything the command line can set, for the interactive app and the headless export alike:
+//   plane --vectors field.pvec --stream /tmp/plane.fifo --fps-cap 60
+//   plane --headless --size 1920x1080 --frames 360 --out frames/frame_%05d.png --vectors field.txt
+struct AppOptions {
+	HeadlessOptions headless; //--headless, --size, --frames, --out (see headless.h)
+	std::string vectorsPath; //--vectors, a .pvec file or text with "x y z [r g b]" per line, loaded at start
+	std::string streamSource; //--stream, live updates in the interactive app (see vectorStream.h)
+	bool benchBvh = false; //--bench-bvh, prints the BVH query benchmark and exits (see bvhBenchmark.h)
+	bool idle = true; //--no-idle draws every frame instead of only when something changed (see framePacer.h)
+	int frameCap = 0; //--fps-cap N, 0 = no cap
+	bool vsync = true; //--no-vsync
+};
+
+
+//false (after printing why) if the arguments make no sense
+inline bool parseOptions(int argc, char** argv, AppOptions& options) {
+	HeadlessOptions& headless = options.headless;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--headless") {
+			headless.enabled = true;
+		}
+		else if (arg == "--size" && hasValue) {
+			if (std::sscanf(argv[++i], "%dx%d", &headless.width, &headless.height) != 2 || headless.width <= 0 || headless.height <= 0) {
+				std::cout << "ERROR::HEADLESS::BAD_SIZE " << argv[i] << " (expected WIDTHxHEIGHT)\n";
+				return false;
+			}
+		}
+		else if (arg == "--frames" && hasValue) {
+			headless.frames = std::atoi(argv[++i]);
+			if (headless.frames <= 0) {
+				std::cout << "ERROR::HEADLESS::BAD_FRAME_COUNT " << argv[i] << "\n";
+				return false;
+			}
+		}
+		else if (arg == "--out" && hasValue) {
+			headless.outPattern = argv[++i];
+			if (!validOutPattern(headless.outPattern)) {
+				std::cout << "ERROR::HEADLESS::BAD_OUT_PATTERN " << argv[i] << " (needs one %d or %0Nd for the frame number, % otherwise only as %%)\n";
+				return false;
+			}
+		}
+		else if (arg == "--vectors" && hasValue) {
+			options.vectorsPath = argv[++i];
+		}
+		else if (arg == "--stream" && hasValue) {
+			options.streamSource = argv[++i];
+		}
+		else if (arg == "--bench-bvh") {
+			options.benchBvh = true;
+		}
+		else if (arg == "--no-idle") {
+			options.idle = false;
+		}
+		else if (arg == "--fps-cap" && hasValue) {
+			options.frameCap = std::atoi(argv[++i]);
+			if (options.frameCap < 0) {
+				std::cout << "ERROR::ARGS::BAD_FPS_CAP " << argv[i] << "\n";
+				return false;
+			}
+		}
+		else if (arg == "--no-vsync") {
+			options.vsync = false;
+		}
+		else {
+			std::cout << "ERROR::ARGS::UNKNOWN " << arg << "\n";
+			return false;
+		}
+	}
+	return true;
+}
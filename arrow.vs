@@ -0,0 +1,60 @@
+#version 330 core
+layout (location = 0) in vec4 aMesh;      // xy = unit radial offset, z = along the part, w = 0 shaft / 1 head
+layout (location = 1) in vec3 aOrigin;    // per instance
+layout (location = 2) in vec3 aDirection; // per instance
+layout (location = 3) in vec4 aColor;     // per instance, packed RGBA8
+
+
+uniform mat4 model;
+layout (std140) uniform Camera
+{
+   mat4 view;
+   mat4 projection;
+   vec4 cameraPosition;
+};
+
+uniform float shaftRadius;
+uniform float headLength;
+uniform float headRadius;
+uniform int instanceBase; // first arrow of the draw when only some runs are drawn (ArrowRenderer::showRanges)
+
+out vec3 vecColor;
+flat out uint vecId; // buffer index + 1, for the picking pass (pick.fs), 0 means nothing
+
+
+
+void main()
+{
+   float len = length(aDirection);
+   vec3 axis = len > 1e-6 ? aDirection / len : vec3(0.0, 1.0, 0.0);
+
+   // any vector not parallel to the axis gives us the other two directions
+   vec3 helper = abs(axis.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+   vec3 u = normalize(cross(axis, helper));
+   vec3 v = cross(axis, u);
+
+   // short arrows get a smaller head so it never eats the whole shaft
+   float head = min(headLength, 0.4 * len);
+   float headR = headRadius * (head / headLength);
+
+   float along;
+   float radius;
+   if (aMesh.w < 0.5) {
+      along = aMesh.z * (len - head);
+      radius = shaftRadius;
+   }
+   else {
+      along = (len - head) + aMesh.z * head;
+      radius = headR;
+   }
+
+   vec3 radial = u * aMesh.x + v * aMesh.y;
+   vec3 localPos = aOrigin + axis * along + radial * radius;
+   gl_Position = projection * view * model * vec4(localPos, 1.0);
+
+   // cheap fixed light so the shaft and cone read as 3D
+   vec3 normal = normalize(mat3(model) * (radial + axis * aMesh.w * 0.4 + axis * 1e-3));
+   float shade = 0.6 + 0.4 * max(dot(normal, normalize(vec3(0.3, 0.8, 0.5))), 0.0);
+   vecColor = aColor.rgb * shade;
+   vecId = uint(gl_InstanceID + instanceBase) + 1u;
+}
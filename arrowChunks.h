@@ -0,0 +1,282 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include "arrowRenderer.h"
+
+// The user arrows, sorted into spatially coherent chunks so the ones outside the view aren't drawn.
+// Arrows are ordered along a Morton curve over their tips and cut into runs of CHUNK_SIZE, each chunk keeps the
+// bounds of its tips and of its origins. cull() tests those against the frustum every frame and the layer only
+// draws the chunks that can be seen, neighbouring visible chunks go out as one instanced draw.
+// Arrows are written by their dense index (the vectors' order) and only the chunk ordered layer lives on the gpu,
+// picks and gpu batches use it too and denseAt() turns a place in it back into a dense index. Nothing is sorted
+// per change: edits land in place and only grow the bounds of their chunk, new arrows go into trailing chunks,
+// a removed one's place is taken by the layer's last arrow. Once those changes add up to a quarter of the set
+// (chunks have gone loose) the next upload() sorts everything again, so the sort stays amortized O(1) per change.
+//   chunks.resize(n); chunks.set(i, arrow); chunks.upload();   edits, then once before drawing
+//   chunks.cull(projection * view * model);                    every frame, then draw chunks.layer()
+class ArrowChunks {
+public:
+	static constexpr size_t CHUNK_SIZE = 4096;
+
+	ArrowRenderer& layer() { return m_layer; }
+
+	size_t size() const { return m_slotOf.size(); }
+	size_t chunkCount() const { return m_chunks.size(); }
+	size_t visibleChunks() const { return m_visibleChunks; }
+	size_t visibleArrows() const { return m_visibleArrows; }
+
+	//place in the layer (an id from a pick, minus 1) -> dense index
+	size_t denseAt(size_t slot) const { return m_denseOf[slot]; }
+	//goes up whenever places in the layer change hands (a removal, a re-sort), an answer about the layer from
+	//before that means nothing anymore
+	uint64_t layout() const { return m_layout; }
+
+
+	//for a count that is coming in pieces (see VectorMirror::apply)
+	void reserve(size_t count) {
+		m_slotOf.reserve(count);
+		m_denseOf.reserve(count);
+		m_layer.instances().reserve(count);
+	};
+
+	//new dense entries get the next places in the layer (set() gives them their arrow and bounds), dropped ones
+	//hand theirs to the layer's last arrow
+	void resize(size_t count) {
+		size_t old = m_slotOf.size();
+		for (size_t dense = old; dense > count; --dense) {
+			vacate(m_slotOf[dense - 1]);
+			++m_edits;
+		}
+		m_slotOf.resize(count);
+		for (size_t dense = old; dense < count; ++dense) {
+			m_slotOf[dense] = m_denseOf.size();
+			m_denseOf.push_back((uint32_t)dense);
+		}
+		m_layer.instances().resize(m_denseOf.size());
+		m_chunks.resize((m_denseOf.size() + CHUNK_SIZE - 1) / CHUNK_SIZE);
+	};
+
+	void set(size_t dense, const ArrowInstance& arrow) {
+		size_t slot = m_slotOf[dense];
+		m_layer.instances().set(slot, arrow);
+		m_chunks[slot / CHUNK_SIZE].grow(arrow);
+		++m_edits;
+	};
+
+	//dense entries [dense, dense + count); runs that sit side by side in the layer (all of a fresh append) go in
+	//as one copy
+	void set(size_t dense, const ArrowInstance* arrows, size_t count) {
+		for (size_t done = 0; done < count;) {
+			size_t slot = m_slotOf[dense + done];
+			size_t run = 1;
+			while (done + run < count && m_slotOf[dense + done + run] == slot + run) {
+				++run;
+			}
+			m_layer.instances().set(slot, arrows + done, run);
+			for (size_t k = 0; k < run; ++k) {
+				m_chunks[(slot + k) / CHUNK_SIZE].grow(arrows[done + k]);
+			}
+			done += run;
+		}
+		m_edits += count;
+	};
+
+	//sorts first if enough changed since the last time, unless more is still on its way (a load replayed over
+	//several frames): then it is drawn a bit loose until the last piece is in, and sorted once
+	void upload(bool resort = true) {
+		if (resort && m_edits > size() / 4 + CHUNK_SIZE) {
+			rebuild();
+		}
+		m_layer.upload();
+	};
+
+
+	//keeps the chunks that may be inside the frustum of clip = projection * view * model, in model space
+	void cull(const glm::mat4& clip) {
+		//the six planes straight from the matrix rows (Gribb / Hartmann), normalized so the margin is a distance
+		glm::vec4 planes[6];
+		for (int axis = 0; axis < 3; ++axis) {
+			glm::vec4 row(clip[0][axis], clip[1][axis], clip[2][axis], clip[3][axis]);
+			glm::vec4 w(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+			planes[2 * axis] = w + row;
+			planes[2 * axis + 1] = w - row;
+		}
+		for (glm::vec4& plane : planes) {
+			plane /= std::max(glm::length(glm::vec3(plane)), 1e-12f);
+		}
+		//arrows are thicker than their segment
+		float margin = std::max(m_layer.shaftRadius, m_layer.headRadius);
+
+		m_ranges.clear();
+		m_visibleChunks = 0;
+		m_visibleArrows = 0;
+		for (size_t c = 0; c < m_chunks.size(); ++c) {
+			if (!m_chunks[c].visible(planes, margin)) {
+				continue;
+			}
+			size_t first = c * CHUNK_SIZE;
+			size_t count = std::min(CHUNK_SIZE, m_layer.size() - first);
+			if (!m_ranges.empty() && m_ranges.back().first + m_ranges.back().count == first) {
+				m_ranges.back().count += count;
+			}
+			else {
+				m_ranges.push_back(ArrowRange{ first, count });
+			}
+			++m_visibleChunks;
+			m_visibleArrows += count;
+		}
+		m_layer.showRanges(m_ranges);
+	};
+
+	//everything again, for when culling is switched off
+	void showAll() {
+		m_layer.showAll();
+		m_visibleChunks = m_chunks.size();
+		m_visibleArrows = m_layer.size();
+	};
+
+
+
+private:
+	struct Bounds {
+		glm::vec3 min = glm::vec3(1e30f);
+		glm::vec3 max = glm::vec3(-1e30f);
+
+		void grow(const glm::vec3& point) {
+			min = glm::min(min, point);
+			max = glm::max(max, point);
+		};
+
+		//the box is entirely on the negative side of the plane
+		bool outside(const glm::vec4& plane, float margin) const {
+			glm::vec3 corner(plane.x > 0.0f ? max.x : min.x, plane.y > 0.0f ? max.y : min.y, plane.z > 0.0f ? max.z : min.z);
+			return glm::dot(glm::vec3(plane), corner) + plane.w < -margin;
+		};
+	};
+
+	//origins and tips apart: every user arrow starts at 0, one box over both would always reach the origin
+	struct Chunk {
+		Bounds origins;
+		Bounds tips;
+
+		void grow(const ArrowInstance& arrow) {
+			origins.grow(arrow.origin);
+			tips.grow(arrow.origin + arrow.direction);
+		};
+
+		//a segment is outside if both its ends are outside the same plane
+		bool visible(const glm::vec4* planes, float margin) const {
+			for (int p = 0; p < 6; ++p) {
+				if (origins.outside(planes[p], margin) && tips.outside(planes[p], margin)) {
+					return false;
+				}
+			}
+			return true;
+		};
+	};
+
+	ArrowRenderer m_layer; //the arrows in chunk order, the only copy on the gpu
+	std::vector<Chunk> m_chunks;
+	std::vector<size_t> m_slotOf; //dense index -> place in the layer
+	std::vector<uint32_t> m_denseOf; //place in the layer -> dense index
+	std::vector<uint64_t> m_keys; //morton code << 32 | place in the layer, then sorted (kept to save the allocation)
+	std::vector<uint64_t> m_swap;
+	std::vector<ArrowRange> m_ranges;
+	size_t m_edits = 0; //changes since the last sort, each one may have loosened a chunk
+	uint64_t m_layout = 0;
+	size_t m_visibleChunks = 0;
+	size_t m_visibleArrows = 0;
+
+
+	//the layer's last arrow moves into slot, which belonged to a dense entry that is going away
+	void vacate(size_t slot) {
+		DynamicBuffer<ArrowInstance>& arrows = m_layer.instances();
+		size_t last = arrows.size() - 1;
+		if (slot != last) {
+			arrows.set(slot, arrows[last]);
+			m_chunks[slot / CHUNK_SIZE].grow(arrows[last]);
+			m_denseOf[slot] = m_denseOf[last];
+			m_slotOf[m_denseOf[slot]] = slot;
+		}
+		arrows.resize(last);
+		m_denseOf.pop_back();
+		++m_layout;
+	};
+
+	//sorts the layer as it is now, chunks get tight bounds again
+	void rebuild() {
+		const DynamicBuffer<ArrowInstance>& arrows = m_layer.instances();
+		size_t count = arrows.size();
+		m_edits = 0;
+		++m_layout;
+		m_chunks.assign((count + CHUNK_SIZE - 1) / CHUNK_SIZE, Chunk{});
+		if (count == 0) {
+			return;
+		}
+
+		//10 bits per axis over the box of all tips
+		Bounds all;
+		for (size_t s = 0; s < count; ++s) {
+			all.grow(arrows[s].origin + arrows[s].direction);
+		}
+		glm::vec3 scale = 1023.0f / glm::max(all.max - all.min, glm::vec3(1e-12f));
+		m_keys.resize(count);
+		for (size_t s = 0; s < count; ++s) {
+			glm::vec3 cell = (arrows[s].origin + arrows[s].direction - all.min) * scale;
+			uint64_t code = spread(cellOf(cell.x)) | (spread(cellOf(cell.y)) << 1) | (spread(cellOf(cell.z)) << 2);
+			m_keys[s] = (code << 32) | s;
+		}
+		sortKeys();
+
+		std::vector<ArrowInstance> ordered(count);
+		std::vector<uint32_t> denseOf(count);
+		for (size_t slot = 0; slot < count; ++slot) {
+			size_t from = (size_t)(m_keys[slot] & 0xFFFFFFFFu);
+			ordered[slot] = arrows[from];
+			denseOf[slot] = m_denseOf[from];
+			m_slotOf[denseOf[slot]] = slot;
+			m_chunks[slot / CHUNK_SIZE].grow(arrows[from]);
+		}
+		m_denseOf.swap(denseOf);
+		m_layer.instances().clear();
+		m_layer.instances().append(ordered.data(), count);
+	};
+
+	//LSD radix sort on the 30 bit morton code, three passes of 10 bits, stable so equal cells keep their order
+	void sortKeys() {
+		m_swap.resize(m_keys.size());
+		for (int shift = 32; shift < 62; shift += 10) {
+			size_t counts[1025] = {};
+			for (uint64_t key : m_keys) {
+				++counts[((key >> shift) & 1023) + 1];
+			}
+			for (int b = 0; b < 1024; ++b) {
+				counts[b + 1] += counts[b];
+			}
+			for (uint64_t key : m_keys) {
+				m_swap[counts[(key >> shift) & 1023]++] = key;
+			}
+			m_keys.swap(m_swap);
+		}
+	};
+
+	//clamped before the cast, a NaN fails the test and goes into cell 0
+	static uint32_t cellOf(float value) {
+		return value > 0.0f ? (uint32_t)std::min(value, 1023.0f) : 0;
+	};
+
+	//puts two zero bits between each of the 10 low bits
+	static uint64_t spread(uint32_t value) {
+		uint64_t x = value;
+		x = (x | (x << 16)) & 0x030000FF;
+		x = (x | (x << 8)) & 0x0300F00F;
+		x = (x | (x << 4)) & 0x030C30C3;
+		x = (x | (x << 2)) & 0x09249249;
+		return x;
+	};
+};
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "shader.h"
+#include "dynamicBuffer.h"
+
+// One arrow on the GPU: 28 bytes, everything else comes from the shared mesh.
+struct ArrowInstance {
+	glm::vec3 origin;
+	glm::vec3 direction; //tip = origin + direction
+	uint32_t color; //packed RGBA8 (see packColor in vertex.h)
+};
+
+// A run of instances in the buffer, [first, first + count).
+struct ArrowRange {
+	size_t first;
+	size_t count;
+};
+
+
+// Draws every user vector as a shaft + cone arrow with a single glDrawArraysInstanced.
+// The mesh is a unit arrow stored once; arrow.vs orients and stretches it per instance.
+// showRanges() limits the draw to some runs of the buffer (the visible chunks, see arrowChunks.h): GL 3.3 has no
+// base instance, so every run points the instance attributes at its first arrow and gets its own draw.
+class ArrowRenderer {
+public:
+	float shaftRadius = 0.004f;
+	float headLength = 0.03f;
+	float headRadius = 0.012f;
+
+	ArrowRenderer(int segments = 12) {
+		generateMesh(segments);
+		setupBuffers();
+	};
+
+	~ArrowRenderer() {
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &meshVBO);
+	}; //the instance buffer cleans itself up
+
+	ArrowRenderer(const ArrowRenderer&) = delete;
+	ArrowRenderer& operator=(const ArrowRenderer&) = delete;
+
+
+	//edit arrows through this, only the touched instances get uploaded
+	DynamicBuffer<ArrowInstance>& instances() { return m_instances; }
+	const DynamicBuffer<ArrowInstance>& instances() const { return m_instances; }
+
+	size_t size() const { return m_instances.size(); }
+
+	void upload() {
+		m_instances.upload();
+	};
+
+	//only these runs from now on, until showAll()
+	void showRanges(const std::vector<ArrowRange>& ranges) {
+		m_ranges = ranges;
+		m_allVisible = false;
+	};
+
+	void showAll() {
+		m_allVisible = true;
+	};
+
+	void draw(const Shader& shader) {
+		if (m_instances.empty()) {
+			return;
+		}
+		shader.setFloat(uShaftRadius, shaftRadius);
+		shader.setFloat(uHeadLength, headLength);
+		shader.setFloat(uHeadRadius, headRadius);
+
+		glBindVertexArray(VAO);
+		if (m_allVisible) {
+			shader.setInt(uInstanceBase, 0);
+			glDrawArraysInstanced(GL_TRIANGLES, 0, (GLsizei)mesh.size(), (GLsizei)m_instances.size());
+		}
+		else if (!m_ranges.empty()) {
+			glBindBuffer(GL_ARRAY_BUFFER, m_instances.ID);
+			for (const ArrowRange& range : m_ranges) {
+				//gl_InstanceID starts over in every draw, instanceBase keeps the ids those of the buffer
+				shader.setInt(uInstanceBase, (int)range.first);
+				pointInstancesAt(range.first);
+				glDrawArraysInstanced(GL_TRIANGLES, 0, (GLsizei)mesh.size(), (GLsizei)range.count);
+			}
+			pointInstancesAt(0);
+		}
+		glBindVertexArray(0);
+	};
+
+
+
+private:
+	//arrow.vs, hashed at compile time (see shader.h)
+	static constexpr UniformId uShaftRadius{ "shaftRadius" };
+	static constexpr UniformId uHeadLength{ "headLength" };
+	static constexpr UniformId uHeadRadius{ "headRadius" };
+	static constexpr UniformId uInstanceBase{ "instanceBase" };
+
+	unsigned int VAO;
+	unsigned int meshVBO;
+
+	//x, y = unit radial offset, z = how far along the part (0..1), w = 0 for shaft, 1 for head
+	std::vector<glm::vec4> mesh;
+
+	DynamicBuffer<ArrowInstance> m_instances;
+	std::vector<ArrowRange> m_ranges;
+	bool m_allVisible = true;
+
+
+	void generateMesh(int segments) {
+		mesh.clear();
+
+		const float twoPi = 6.28318530718f;
+		for (int i = 0; i < segments; ++i) {
+			float a0 = twoPi * i / segments;
+			float a1 = twoPi * (i + 1) / segments;
+			glm::vec2 r0(std::cos(a0), std::sin(a0));
+			glm::vec2 r1(std::cos(a1), std::sin(a1));
+
+			//SHAFT: side quad + bottom cap
+			mesh.push_back(glm::vec4(r0.x, r0.y, 0.0f, 0.0f));
+			mesh.push_back(glm::vec4(r1.x, r1.y, 0.0f, 0.0f));
+			mesh.push_back(glm::vec4(r1.x, r1.y, 1.0f, 0.0f));
+
+			mesh.push_back(glm::vec4(r0.x, r0.y, 0.0f, 0.0f));
+			mesh.push_back(glm::vec4(r1.x, r1.y, 1.0f, 0.0f));
+			mesh.push_back(glm::vec4(r0.x, r0.y, 1.0f, 0.0f));
+
+			mesh.push_back(glm::vec4(0.0f, 0.0f, 0.0f, 0.0f));
+			mesh.push_back(glm::vec4(r1.x, r1.y, 0.0f, 0.0f));
+			mesh.push_back(glm::vec4(r0.x, r0.y, 0.0f, 0.0f));
+
+			//HEAD: cone side + base cap
+			mesh.push_back(glm::vec4(r0.x, r0.y, 0.0f, 1.0f));
+			mesh.push_back(glm::vec4(r1.x, r1.y, 0.0f, 1.0f));
+			mesh.push_back(glm::vec4(0.0f, 0.0f, 1.0f, 1.0f)); //tip
+
+			mesh.push_back(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+			mesh.push_back(glm::vec4(r1.x, r1.y, 0.0f, 1.0f));
+			mesh.push_back(glm::vec4(r0.x, r0.y, 0.0f, 1.0f));
+		}
+	};
+
+
+	void setupBuffers() {
+		glGenBuffers(1, &meshVBO);
+
+		glGenVertexArrays(1, &VAO);
+		glBindVertexArray(VAO);
+
+		//static mesh, one per vertex
+		glBindBuffer(GL_ARRAY_BUFFER, meshVBO);
+		glBufferData(GL_ARRAY_BUFFER, mesh.size() * sizeof(glm::vec4), mesh.data(), GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+		glEnableVertexAttribArray(0);
+
+		//instance data, advances once per arrow
+		glBindBuffer(GL_ARRAY_BUFFER, m_instances.ID);
+		pointInstancesAt(0);
+		for (unsigned int attribute = 1; attribute <= 3; ++attribute) {
+			glEnableVertexAttribArray(attribute);
+			glVertexAttribDivisor(attribute, 1);
+		}
+
+		glBindVertexArray(0);
+	};
+
+	//instance attributes starting at arrow `first`, with the VAO and the instance buffer bound
+	void pointInstancesAt(size_t first) {
+		size_t base = first * sizeof(ArrowInstance);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ArrowInstance), (void*)(base + offsetof(ArrowInstance, origin)));
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(ArrowInstance), (void*)(base + offsetof(ArrowInstance, direction)));
+		glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ArrowInstance), (void*)(base + offsetof(ArrowInstance, color)));
+	};
+};
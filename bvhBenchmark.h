@@ -0,0 +1,133 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "vectorBvh.h"
+#include "taskPool.h"
+
+// plane --bench-bvh
+// Query cost against the number of vectors: build time, then ray / box / nearest queries through the BVH next
+// to a plain scan over every vector, and single vector refits. Vectors are random in the [-0.5, 0.5] cube like
+// the grid. The scans run the first queries only on big sets (they are the slow side), on those both sides
+// must give the same answers or it fails with an error.
+inline int benchmarkBvh() {
+	TaskPool pool;
+	const size_t sizes[] = { 1000, 10000, 100000, 1000000 };
+	const int queries = 1000;
+	const float radius = 0.002f;
+
+	auto now = [] { return std::chrono::steady_clock::now(); };
+	auto micros = [](std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to, int count) {
+		return std::chrono::duration<double, std::micro>(to - from).count() / count;
+	};
+
+	std::printf("%9s %10s %8s | %-22s | %-22s | %-22s | %9s\n", "vectors", "build ms", "nodes",
+		"ray us (bvh / scan)", "box us (bvh / scan)", "nearest us (bvh / scan)", "refit us");
+	for (size_t n : sizes) {
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> cube(-0.5f, 0.5f);
+		VectorArrays tips;
+		tips.reserve(n);
+		for (size_t i = 0; i < n; ++i) {
+			tips.push_back(glm::vec3(cube(random), cube(random), cube(random)));
+		}
+
+		VectorBvh bvh;
+		auto start = now();
+		bvh.build(tips, &pool);
+		double buildMs = micros(start, now(), 1) / 1000.0;
+
+		//rays from a camera-ish distance through the cube, small boxes, points anywhere
+		std::vector<glm::vec3> from(queries), direction(queries), low(queries), high(queries), points(queries);
+		for (int q = 0; q < queries; ++q) {
+			from[q] = glm::normalize(glm::vec3(cube(random), cube(random), cube(random))) * 1.5f;
+			direction[q] = glm::normalize(glm::vec3(cube(random), cube(random), cube(random)) * 0.6f - from[q]);
+			low[q] = glm::vec3(cube(random), cube(random), cube(random)) * 0.9f;
+			high[q] = low[q] + 0.05f;
+			points[q] = glm::vec3(cube(random), cube(random), cube(random));
+		}
+
+		int scans = (int)std::min<size_t>(queries, std::max<size_t>(10, 100000000 / n));
+		int mismatches = 0;
+
+		std::vector<float> rayT(queries, -1.0f);
+		start = now();
+		for (int q = 0; q < queries; ++q) {
+			bvh.raycast(from[q], direction[q], radius, &rayT[q]);
+		}
+		double rayBvh = micros(start, now(), queries);
+		start = now();
+		for (int q = 0; q < scans; ++q) {
+			float bestT = -1.0f;
+			for (size_t i = 0; i < n; ++i) {
+				float t;
+				if (VectorBvh::raySegmentDistance2(from[q], direction[q], tips.get(i), t) <= radius * radius && (bestT < 0.0f || t < bestT)) {
+					bestT = t;
+				}
+			}
+			mismatches += bestT != rayT[q];
+		}
+		double rayScan = micros(start, now(), scans);
+
+		std::vector<size_t> insideCount(queries);
+		std::vector<size_t> inside;
+		start = now();
+		for (int q = 0; q < queries; ++q) {
+			inside.clear();
+			bvh.queryBox(low[q], high[q], inside);
+			insideCount[q] = inside.size();
+		}
+		double boxBvh = micros(start, now(), queries);
+		start = now();
+		for (int q = 0; q < scans; ++q) {
+			size_t count = 0;
+			for (size_t i = 0; i < n; ++i) {
+				glm::vec3 tip = tips.get(i);
+				count += glm::all(glm::greaterThanEqual(tip, low[q])) && glm::all(glm::lessThanEqual(tip, high[q]));
+			}
+			mismatches += count != insideCount[q];
+		}
+		double boxScan = micros(start, now(), scans);
+
+		std::vector<float> nearestDistance(queries);
+		start = now();
+		for (int q = 0; q < queries; ++q) {
+			bvh.nearest(points[q], 1e30f, &nearestDistance[q]);
+		}
+		double nearestBvh = micros(start, now(), queries);
+		start = now();
+		for (int q = 0; q < scans; ++q) {
+			float best = 1e30f;
+			for (size_t i = 0; i < n; ++i) {
+				best = std::min(best, VectorBvh::pointSegmentDistance2(points[q], tips.get(i)));
+			}
+			mismatches += std::sqrt(best) != nearestDistance[q];
+		}
+		double nearestScan = micros(start, now(), scans);
+
+		start = now();
+		for (int q = 0; q < queries; ++q) {
+			size_t i = random() % n;
+			bvh.refit(i, tips.get(i) * 0.99f);
+		}
+		double refit = micros(start, now(), queries);
+
+		char ray[32], box[32], closest[32];
+		std::snprintf(ray, sizeof(ray), "%.2f / %.1f", rayBvh, rayScan);
+		std::snprintf(box, sizeof(box), "%.2f / %.1f", boxBvh, boxScan);
+		std::snprintf(closest, sizeof(closest), "%.2f / %.1f", nearestBvh, nearestScan);
+		std::printf("%9zu %10.2f %8zu | %-22s | %-22s | %-22s | %9.3f\n", n, buildMs, bvh.nodeCount(), ray, box, closest, refit);
+		if (mismatches > 0) {
+			std::printf("ERROR::BVH::MISMATCH %d of %d scanned queries disagree\n", mismatches, 3 * scans);
+			return -1;
+		}
+	}
+	return 0;
+}
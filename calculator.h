@@ -3,49 +3,583 @@
 
 #include <glm/glm.hpp>
 #include <vector>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 #include <iostream>
 
-enum Operation {
-	ADD,
-	MULTIPLY
-};
+#include "vectorKernels.h"
+#include "expressionGraph.h"
+#include "vectorStore.h"
+#include "taskPool.h"
 
 struct Calculation {
-	Operation op;
-	std::vector<glm::vec3*> vectors;
-	glm::vec3 result;
+	Operation op = ADD;
+	std::vector<NodeId> vectors; //user vectors or earlier results, in the order they were picked
+	std::vector<std::string> labels; //"v1", "r2", ... one per picked vector
+	std::string text;                //"v1 + v3 + r2"
+	float scalar = 1.0f;             //MULTIPLY factor
+	std::vector<NodeId> results;
+};
+
+//3x3 or 4x4, kept as a mat4 either way (a 3x3 just has no translation)
+//only the affine part is used: the bottom row of a 4x4 is always 0 0 0 1
+struct Matrix {
+	glm::mat4 value = glm::mat4(1.0f);
+	int size = 3;
+};
+
+//a batch over every vector in the store (see Calculator::runBatch)
+struct BatchResult {
+	Operation op = ADD;
+	size_t inputCount = 0;
+	VectorArrays vectors;
+	std::vector<float> scalars;
+	double milliseconds = 0.0;
+	unsigned int version = 0; //0 until the first batch finished
 };
 
+// Batch vector math over structure-of-arrays data, using the widest SIMD kernels the cpu supports
+// (see vectorKernels.h), plus the calculator the OPERATIONS window drives:
+//   ADD / SUBTRACT  fold every picked vector into one result (v1 + v2 + ..., v1 - v2 - ...)
+//   MULTIPLY        scales every picked vector by the scalar
+//   DOT / CROSS     work on the picked vectors in pairs (v1 . v2, v3 . v4, ...)
+//   TRANSFORM       applies the matrix chain to every picked vector
+// Results are live: they are nodes in an ExpressionGraph fed by the user vectors, so editing a vector
+// recomputes only the results that depend on it. Results can be picked again to chain calculations.
+// Vectors are referred to by VectorHandle, a removed vector leaves its results at their last value.
+// Matrices are picked into a chain that is folded into one matrix, which then goes over all the picked vectors
+// in one SIMD kernel call. The transformed vectors follow edits to the vectors and to the matrices too.
+// Batches over the whole store run on the task pool in chunks; the finished result goes into a back buffer
+// that beginFrame() swaps to the front, so the update thread never waits for (or sees half of) a batch.
 class Calculator {
 public:
-	Calculator(std::vector<glm::vec3>* userPoints):
-	m_userPoints {userPoints}
+	Calculator(VectorStore* vectors, TaskPool* pool = nullptr):
+	m_vectors {vectors}, m_pool {pool}
 	{
-		std::cout << "Calculator made\n";
+		std::cout << "Calculator made (" << kernels::active().name << " kernels)\n";
+	}
+
+	~Calculator() {
+		waitForBatch();
+	}
+
+
+	// ============ batch engine ============
+
+	static glm::vec3 sum(const VectorArrays& a, kernels::ReductionMode mode = kernels::ReductionMode::DETERMINISTIC) {
+		return kernels::reduce(kernels::lanes(a), a.size(), mode);
+	}
+
+	//out[i] = m * a[i] (affine), out may be a
+	static void transform(const glm::mat4& m, const VectorArrays& a, VectorArrays& out) {
+		out.resize(a.size());
+		kernels::active().transform(m, kernels::lanes(a), kernels::lanes(out), a.size());
+	}
+
+	//elementwise out[i] = a[i] op b[i] (MULTIPLY: a[i] * scalar, DOT writes scalarOut instead of out)
+	//a and b must be the same size, out may be a or b
+	static void evaluate(Operation op, const VectorArrays& a, const VectorArrays& b, float scalar, VectorArrays& out, std::vector<float>& scalarOut) {
+		const kernels::KernelTable& k = kernels::active();
+		size_t n = a.size();
+		if (op == DOT) {
+			scalarOut.resize(n);
+			k.dot(kernels::lanes(a), kernels::lanes(b), scalarOut.data(), n);
+			return;
+		}
+		out.resize(n);
+		switch (op) {
+		case ADD:
+			k.add(kernels::lanes(a), kernels::lanes(b), kernels::lanes(out), n);
+			break;
+		case SUBTRACT:
+			k.subtract(kernels::lanes(a), kernels::lanes(b), kernels::lanes(out), n);
+			break;
+		case MULTIPLY:
+			k.scale(kernels::lanes(a), scalar, kernels::lanes(out), n);
+			break;
+		case CROSS:
+			k.cross(kernels::lanes(a), kernels::lanes(b), kernels::lanes(out), n);
+			break;
+		default:
+			break;
+		}
+	}
+
+	static const char* kernelName() { return kernels::active().name; }
+
+	//how ADD / SUBTRACT sum up, for both the live results and the batches
+	void setReductionMode(kernels::ReductionMode mode) {
+		m_reduction = mode;
+		m_graph.setReductionMode(mode);
+	}
+
+	kernels::ReductionMode reductionMode() const { return m_reduction; }
+
+
+	// ============ whole store batches ============
+
+	//runs op over every vector in the store, in the background if there is a pool:
+	//  ADD / SUBTRACT  v1 + v2 + ... / v1 - v2 - ...  (one vector)
+	//  MULTIPLY        every vector * scalar
+	//  DOT / CROSS     every vector . v1 / x v1
+	//  TRANSFORM       every vector through the folded matrix chain
+	//false if the previous batch is still running
+	bool runBatch(Operation op, float scalar) {
+		if (m_batchRunning) {
+			return false;
+		}
+		//the store keeps changing on the update thread, the batch works on its own copy
+		std::shared_ptr<const VectorArrays> input = std::make_shared<VectorArrays>(m_vectors->values());
+		kernels::ReductionMode mode = m_reduction;
+		glm::mat4 matrix = chainMatrix();
+		m_batchRunning = true;
+
+		auto job = [this, input, op, scalar, mode, matrix]() {
+			BatchResult result;
+			auto start = std::chrono::steady_clock::now();
+			computeBatch(*input, op, scalar, mode, matrix, result);
+			result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			{
+				std::lock_guard<std::mutex> lock(m_batchMutex);
+				result.version = ++m_batchVersion;
+				m_back = std::move(result);
+				m_backReady = true;
+			}
+			m_batchRunning = false;
+		};
+		if (m_pool != nullptr) {
+			m_pool->submit(job);
+		}
+		else {
+			job();
+		}
+		return true;
+	}
+
+	//update thread, start of the tick: publishes a finished batch, true if batchResult() changed
+	bool beginFrame() {
+		std::lock_guard<std::mutex> lock(m_batchMutex);
+		if (!m_backReady) {
+			return false;
+		}
+		std::swap(m_front, m_back);
+		m_backReady = false;
+		return true;
+	}
+
+	const BatchResult& batchResult() const { return m_front; }
+	bool batchRunning() const { return m_batchRunning; }
+
+	void waitForBatch() const {
+		while (m_batchRunning) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+
+	// ============ user vectors ============
+
+	//call after the vector was edited, marks every result (and the transformed set) built on it dirty
+	void vectorChanged(VectorHandle vector) {
+		if (vector.index < m_inputs.size() && m_inputs[vector.index].generation == vector.generation
+			&& m_inputs[vector.index].node != INVALID_NODE && m_vectors->valid(vector)) {
+			m_graph.setInput(m_inputs[vector.index].node, m_vectors->value(vector));
+			if (m_transformSet.count(m_inputs[vector.index].node) != 0) {
+				m_transformDirty = true;
+			}
+		}
+	}
+
+	//the user list was emptied, every result (and matrix) goes with it
+	void clear() {
+		m_matrices.clear();
+		m_chain.clear();
+		m_transformNodes.clear();
+		m_transformSet.clear();
+		m_transformed.clear();
+		m_transformDirty = true;
+		m_graph.clear();
+		m_inputs.clear();
+		m_results.clear();
+		m_scalarResults.clear();
+		m_resultSlots.clear();
+		calculationList.clear();
+		clearCurrent();
+	}
+
+
+	// ============ matrices ============
+
+	//a new identity matrix, returns its index
+	size_t addMatrix(int size) {
+		Matrix matrix;
+		matrix.size = size == 4 ? 4 : 3;
+		m_matrices.push_back(matrix);
+		return m_matrices.size() - 1;
+	}
+
+	//a 3x3 keeps no translation, a 4x4 keeps its bottom row at 0 0 0 1
+	void setMatrix(size_t index, const glm::mat4& value) {
+		if (index >= m_matrices.size()) {
+			return;
+		}
+		glm::mat4& m = m_matrices[index].value;
+		m = value;
+		m[0][3] = m[1][3] = m[2][3] = 0.0f;
+		m[3] = m_matrices[index].size == 4 ? glm::vec4(glm::vec3(value[3]), 1.0f) : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		if (std::find(m_chain.begin(), m_chain.end(), index) != m_chain.end()) {
+			m_transformDirty = true;
+		}
+	}
+
+	const std::vector<Matrix>& matrices() const { return m_matrices; }
+
+	//matrices are applied in the order they are picked: picking A then B transforms by B * A
+	void appendMatrixToChain(size_t index) {
+		if (index < m_matrices.size()) {
+			m_chain.push_back(index);
+			m_transformDirty = true;
+		}
+	}
+
+	void clearChain() {
+		m_chain.clear();
+		m_transformDirty = true;
+	}
+
+	const std::vector<size_t>& chain() const { return m_chain; }
+
+	//the whole chain folded into one matrix, identity if it's empty
+	glm::mat4 chainMatrix() const {
+		glm::mat4 folded(1.0f);
+		for (size_t index : m_chain) {
+			folded = m_matrices[index].value * folded;
+		}
+		return folded;
+	}
+
+	std::string describeChain() const {
+		std::string text;
+		for (size_t i = 0; i < m_chain.size(); ++i) {
+			text += (i > 0 ? " then M" : "M") + std::to_string(m_chain[i] + 1);
+		}
+		return text.empty() ? "identity" : text;
 	}
 
 
-	void appendToCurrent() {
-		//TODO
+	// ============ current calculation (OPERATIONS window) ============
+
+	void setOperation(Operation op) {
+		currentCalculation.op = op;
+	}
+
+	void setScalar(float scalar) {
+		currentCalculation.scalar = scalar;
+	}
+
+	void appendToCurrent(VectorHandle vector) {
+		NodeId input = inputFor(vector);
+		if (input != INVALID_NODE) {
+			pick(input, "v" + std::to_string(m_vectors->denseIndex(vector) + 1));
+		}
+	}
+
+	//picks results()[resultIndex], chaining calculations
+	void appendResultToCurrent(size_t resultIndex) {
+		if (resultIndex < m_results.size()) {
+			pick(m_results[resultIndex], "r" + std::to_string(resultIndex + 1));
+		}
 	}
 
 	void clearCurrent() {
-		//TODO
+		Operation op = currentCalculation.op;
+		float scalar = currentCalculation.scalar;
+		currentCalculation = Calculation();
+		currentCalculation.op = op;
+		currentCalculation.scalar = scalar;
+	}
+
+	const Calculation& current() const { return currentCalculation; }
+	const std::vector<Calculation>& history() const { return calculationList; }
+
+	std::string describeCurrent() const {
+		std::string text;
+		if (currentCalculation.op == TRANSFORM) {
+			text = "(" + describeChain() + ")";
+		}
+		for (size_t i = 0; i < currentCalculation.vectors.size(); ++i) {
+			if (currentCalculation.op == TRANSFORM) {
+				text += (i > 0 ? ", " : " ");
+			}
+			else if (i > 0) {
+				text += std::string(" ") + operationSymbol(currentCalculation.op) + " ";
+			}
+			text += currentCalculation.labels[i];
+		}
+		if (currentCalculation.op == MULTIPLY) {
+			text += " * " + std::to_string(currentCalculation.scalar);
+		}
+		return text;
+	}
+
+
+	//turns the picked vectors into result nodes, they get their values on the next update()
+	const Calculation& calculateCurrent() {
+		Calculation& calc = currentCalculation;
+		const std::vector<NodeId>& picked = calc.vectors;
+		calc.text = describeCurrent();
+		calc.results.clear();
+
+		switch (calc.op) {
+		case ADD:
+		case SUBTRACT:
+			addResult(calc, m_graph.addOperation(calc.op, picked));
+			break;
+		case MULTIPLY:
+			for (NodeId in : picked) {
+				addResult(calc, m_graph.addOperation(MULTIPLY, { in }, calc.scalar));
+			}
+			break;
+		case DOT:
+		case CROSS:
+			if (picked.size() % 2 != 0) {
+				std::cout << "CALCULATOR::ODD_PICK the last vector has no partner, skipped\n";
+			}
+			for (size_t i = 0; i + 1 < picked.size(); i += 2) {
+				addResult(calc, m_graph.addOperation(calc.op, { picked[i], picked[i + 1] }));
+			}
+			break;
+		case TRANSFORM:
+			//not graph nodes, the picked vectors become the transformed set (see updateTransform)
+			m_transformNodes = picked;
+			m_transformSet.clear();
+			m_transformSet.insert(picked.begin(), picked.end());
+			m_transformDirty = true;
+			break;
+		}
+
+		calculationList.push_back(calc);
+		clearCurrent();
+		return calculationList.back();
+	}
+
+
+	//recomputes whatever went dirty since the last call
+	//changedSlots gets the indices into results() whose value changed (new ones included), sorted
+	bool update(std::vector<size_t>& changedSlots) {
+		m_changed.clear();
+		if (!m_graph.evaluate(m_changed)) {
+			return false;
+		}
+		if (!m_transformNodes.empty()) {
+			m_transformDirty = true;
+		}
+		for (NodeId id : m_changed) {
+			auto slot = m_resultSlots.find(id);
+			if (slot != m_resultSlots.end()) {
+				changedSlots.push_back(slot->second);
+			}
+		}
+		std::sort(changedSlots.begin(), changedSlots.end());
+		return true;
 	}
 
+	//vector results in the order they were made, these get drawn
+	const std::vector<NodeId>& results() const { return m_results; }
+	//DOT results
+	const std::vector<NodeId>& scalarResults() const { return m_scalarResults; }
+
+	glm::vec3 resultValue(size_t slot) const { return m_graph.value(m_results[slot]); }
+	const ExpressionGraph& graph() const { return m_graph; }
 
-	void calculateCurrent() {
-		currentCalculation.result = glm::vec3(0.0f, 0.0f, 0.0f);
-		for (int i = 0; i < currentCalculation.vectors.size(); ++i) {
-			currentCalculation.result += currentCalculation.vectors[i];
+
+	//after update(): pushes the transformed set through the folded chain if the chain, a matrix in it
+	//or one of the vectors changed, true if transformed() did
+	bool updateTransform() {
+		if (!m_transformDirty) {
+			return false;
+		}
+		m_transformDirty = false;
+		m_transformInput.clear();
+		for (NodeId id : m_transformNodes) {
+			m_transformInput.push_back(m_graph.value(id));
 		}
-		
+		transform(chainMatrix(), m_transformInput, m_transformed);
+		return true;
 	}
+
+	const VectorArrays& transformed() const { return m_transformed; }
+
+
+
 private:
-	std::vector<Calculation*> calculationList;
-	bool equalPending;
-	bool operatorIsNext;
+	std::vector<Calculation> calculationList;
 	Calculation currentCalculation;
-	std::vector<glm::vec3>* m_userPoints;
-	
-};
\ No newline at end of file
+	VectorStore* m_vectors;
+	TaskPool* m_pool;
+
+	//batch double buffer, m_front belongs to the update thread (sceneUpdater.h), m_back to whoever finishes a batch
+	BatchResult m_front;
+	BatchResult m_back;
+	bool m_backReady = false;
+	unsigned int m_batchVersion = 0;
+	std::mutex m_batchMutex;
+	std::atomic<bool> m_batchRunning{ false };
+	kernels::ReductionMode m_reduction = kernels::ReductionMode::DETERMINISTIC;
+
+	static constexpr size_t BATCH_GRAIN = 1 << 16; //vectors per chunk
+
+	struct Input {
+		uint32_t generation = 0;
+		NodeId node = INVALID_NODE;
+	};
+
+	ExpressionGraph m_graph;
+	std::vector<Input> m_inputs; //by VectorHandle::index, the generation tells if it's still the same vector
+	std::vector<NodeId> m_results;
+	std::vector<NodeId> m_scalarResults;
+	std::unordered_map<NodeId, size_t> m_resultSlots; //vector result node -> index in m_results
+	std::vector<NodeId> m_changed;
+
+	std::vector<Matrix> m_matrices;
+	std::vector<size_t> m_chain; //indices into m_matrices, first applied first
+	std::vector<NodeId> m_transformNodes;
+	std::unordered_set<NodeId> m_transformSet; //the same nodes, so an edit (every stream update) checks in O(1)
+	VectorArrays m_transformInput;
+	VectorArrays m_transformed;
+	bool m_transformDirty = false;
+
+
+	//parallelFor when there is a pool, one chunk after the other otherwise
+	template<typename Body>
+	void forChunks(size_t count, Body body) const {
+		if (m_pool != nullptr) {
+			m_pool->parallelFor(count, BATCH_GRAIN, body);
+			return;
+		}
+		for (size_t begin = 0; begin < count; begin += BATCH_GRAIN) {
+			body(begin, std::min(begin + BATCH_GRAIN, count));
+		}
+	}
+
+	void computeBatch(const VectorArrays& input, Operation op, float scalar, kernels::ReductionMode mode, const glm::mat4& matrix, BatchResult& result) const {
+		const kernels::KernelTable& k = kernels::active();
+		size_t n = input.size();
+		result.op = op;
+		result.inputCount = n;
+		if (n == 0) {
+			return;
+		}
+
+		switch (op) {
+		case ADD:
+		case SUBTRACT: {
+			size_t first = op == SUBTRACT ? 1 : 0;
+			size_t count = n - first;
+			kernels::ConstLanes values = kernels::lanes(input, first);
+			glm::vec3 total(0.0f);
+			if (mode == kernels::ReductionMode::DETERMINISTIC) {
+				//fixed blocks and a fixed tree, exactly what kernels::reduce does on one thread
+				//(BATCH_GRAIN is a multiple of REDUCE_BLOCK, so chunks never split a block)
+				std::vector<glm::vec3> partials(kernels::reduceBlocks(count));
+				forChunks(count, [&](size_t begin, size_t end) {
+					for (size_t block = begin / kernels::REDUCE_BLOCK; block * kernels::REDUCE_BLOCK < end; ++block) {
+						partials[block] = kernels::reduceBlock(k, values, count, block);
+					}
+				});
+				total = kernels::pairwiseSum(partials.data(), partials.size());
+			}
+			else {
+				//per chunk partial sums, added up in chunk order
+				std::vector<glm::vec3> partials((count + BATCH_GRAIN - 1) / BATCH_GRAIN, glm::vec3(0.0f));
+				forChunks(count, [&](size_t begin, size_t end) {
+					partials[begin / BATCH_GRAIN] = k.sum(kernels::ConstLanes{ values.x + begin, values.y + begin, values.z + begin }, end - begin);
+				});
+				for (const glm::vec3& partial : partials) {
+					total += partial;
+				}
+			}
+			result.vectors.push_back(op == ADD ? total : input.get(0) - total);
+			break;
+		}
+		case MULTIPLY:
+			result.vectors.resize(n);
+			forChunks(n, [&](size_t begin, size_t end) {
+				k.scale(kernels::lanes(input, begin), scalar, kernels::lanes(result.vectors, begin), end - begin);
+			});
+			break;
+		case TRANSFORM:
+			result.vectors.resize(n);
+			forChunks(n, [&](size_t begin, size_t end) {
+				k.transform(matrix, kernels::lanes(input, begin), kernels::lanes(result.vectors, begin), end - begin);
+			});
+			break;
+		case DOT:
+		case CROSS: {
+			//v1 broadcast over a chunk-sized buffer, so the pairwise kernels can run against it
+			glm::vec3 first = input.get(0);
+			if (op == DOT) {
+				result.scalars.resize(n);
+			}
+			else {
+				result.vectors.resize(n);
+			}
+			forChunks(n, [&](size_t begin, size_t end) {
+				VectorArrays broadcast;
+				broadcast.x.assign(end - begin, first.x);
+				broadcast.y.assign(end - begin, first.y);
+				broadcast.z.assign(end - begin, first.z);
+				if (op == DOT) {
+					k.dot(kernels::lanes(input, begin), kernels::lanes(broadcast), result.scalars.data() + begin, end - begin);
+				}
+				else {
+					k.cross(kernels::lanes(input, begin), kernels::lanes(broadcast), kernels::lanes(result.vectors, begin), end - begin);
+				}
+			});
+			break;
+		}
+		}
+	}
+
+	//the vector's input node, made the first time it is picked
+	NodeId inputFor(VectorHandle vector) {
+		if (!m_vectors->valid(vector)) {
+			return INVALID_NODE;
+		}
+		if (vector.index >= m_inputs.size()) {
+			m_inputs.resize(vector.index + 1);
+		}
+		Input& input = m_inputs[vector.index];
+		if (input.node == INVALID_NODE || input.generation != vector.generation) {
+			input.generation = vector.generation;
+			input.node = m_graph.addInput(m_vectors->value(vector));
+		}
+		return input.node;
+	}
+
+	void pick(NodeId id, const std::string& label) {
+		currentCalculation.vectors.push_back(id);
+		currentCalculation.labels.push_back(label);
+	}
+
+	void addResult(Calculation& calc, NodeId id) {
+		if (id == INVALID_NODE) {
+			std::cout << "CALCULATOR::INVALID " << operationSymbol(calc.op) << " needs vector inputs\n";
+			return;
+		}
+		calc.results.push_back(id);
+		if (m_graph.isScalar(id)) {
+			m_scalarResults.push_back(id);
+		}
+		else {
+			m_resultSlots[id] = m_results.size();
+			m_results.push_back(id);
+		}
+	}
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "shader.h"
+
+// CPU copy of the "Camera" uniform block. std140 lays mat4 out as four vec4 columns and
+// vec4 needs no padding, so this struct matches the GLSL block byte for byte.
+struct CameraBlock {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec4 position; //w unused
+};
+
+// One uniform buffer shared by every program that declares
+//   layout (std140) uniform Camera { mat4 view; mat4 projection; vec4 cameraPosition; };
+// so the camera is updated with a single glBufferSubData per frame instead of per program.
+class CameraUniforms {
+public:
+	static const unsigned int binding = 0;
+
+	CameraUniforms() {
+		glGenBuffers(1, &UBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), NULL, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, UBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	};
+
+	~CameraUniforms() {
+		glDeleteBuffers(1, &UBO);
+	};
+
+	CameraUniforms(const CameraUniforms&) = delete;
+	CameraUniforms& operator=(const CameraUniforms&) = delete;
+
+
+	//connects a program's Camera block to this buffer, once after it is linked
+	void attach(const Shader& shader) const {
+		shader.bindUniformBlock("Camera", binding);
+	};
+
+	void update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& position) {
+		block.view = view;
+		block.projection = projection;
+		block.position = glm::vec4(position, 1.0f);
+
+		glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &block);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	};
+
+	const CameraBlock& current() const { return block; }
+
+
+
+private:
+	unsigned int UBO;
+	CameraBlock block;
+};
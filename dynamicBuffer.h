@@ -0,0 +1,194 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <glad/glad.h>
+
+// GPU array buffer that mirrors a CPU side std::vector<T>.
+// Storage grows by doubling, and every edit only marks the touched element range dirty,
+// so upload() sends just the changed sub-ranges with glBufferSubData instead of re-uploading everything.
+// The buffer ID never changes, so a VAO pointing at it stays valid after the storage grows.
+template <typename T>
+class DynamicBuffer {
+public:
+	unsigned int ID;
+
+	DynamicBuffer(size_t initialCapacity = 64)
+		: m_capacity{ std::max<size_t>(initialCapacity, 1) } {
+		glGenBuffers(1, &ID);
+		glBindBuffer(GL_ARRAY_BUFFER, ID);
+		glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(T), NULL, GL_DYNAMIC_DRAW);
+	};
+
+	~DynamicBuffer() {
+		glDeleteBuffers(1, &ID);
+	};
+
+	DynamicBuffer(const DynamicBuffer&) = delete;
+	DynamicBuffer& operator=(const DynamicBuffer&) = delete;
+
+
+	size_t size() const { return m_data.size(); }
+	size_t capacity() const { return m_capacity; }
+	bool empty() const { return m_data.empty(); }
+	bool dirty() const { return !m_dirty.empty(); }
+
+	const T& operator[](size_t i) const { return m_data[i]; }
+	const T* data() const { return m_data.data(); }
+
+
+	void push_back(const T& value) {
+		m_data.push_back(value);
+		markDirty(m_data.size() - 1, m_data.size());
+	};
+
+	//one dirty range for the whole block
+	void append(const T* values, size_t count) {
+		m_data.insert(m_data.end(), values, values + count);
+		markDirty(m_data.size() - count, m_data.size());
+	};
+
+	void set(size_t i, const T& value) {
+		m_data[i] = value;
+		markDirty(i, i + 1);
+	};
+
+	//count values into [first, first + count), one dirty range
+	void set(size_t first, const T* values, size_t count) {
+		std::copy(values, values + count, m_data.begin() + first);
+		markDirty(first, first + count);
+	};
+
+	void resize(size_t count, const T& value = T()) {
+		size_t oldSize = m_data.size();
+		m_data.resize(count, value);
+		if (count > oldSize) {
+			markDirty(oldSize, count);
+		}
+		else {
+			clampDirty();
+		}
+	};
+
+	void clear() {
+		m_data.clear();
+		m_dirty.clear();
+	};
+
+
+	//room for count elements on both sides, so growing up to that later neither moves the cpu copy nor sends
+	//everything again. What is there already goes up once more if the gpu storage had to grow
+	void reserve(size_t count) {
+		m_data.reserve(count);
+		if (count <= m_capacity) {
+			return;
+		}
+		while (m_capacity < count) {
+			m_capacity *= 2;
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, ID);
+		glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(T), NULL, GL_DYNAMIC_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, m_data.size() * sizeof(T), m_data.data());
+		m_dirty.clear();
+	};
+
+
+	//for buffers the gpu fills itself (transform feedback): makes the gpu storage hold `count` elements without
+	//sending anything. The cpu copy only follows in size, its contents are stale until the next set() / resize().
+	//Grown storage loses its old contents.
+	void resizeDeviceOnly(size_t count) {
+		m_data.resize(count);
+		m_dirty.clear();
+		if (count > m_capacity) {
+			while (m_capacity < count) {
+				m_capacity *= 2;
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, ID);
+			glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(T), NULL, GL_DYNAMIC_DRAW);
+		}
+	};
+
+
+	//marks [begin, end) as changed, merging with any range it touches
+	void markDirty(size_t begin, size_t end) {
+		if (begin >= end) {
+			return;
+		}
+
+		Range range{ begin, end };
+		auto it = std::lower_bound(m_dirty.begin(), m_dirty.end(), range,
+			[](const Range& a, const Range& b) { return a.end < b.begin; });
+
+		//swallow every following range that overlaps or is adjacent
+		auto last = it;
+		while (last != m_dirty.end() && last->begin <= range.end) {
+			range.begin = std::min(range.begin, last->begin);
+			range.end = std::max(range.end, last->end);
+			++last;
+		}
+		it = m_dirty.erase(it, last);
+		m_dirty.insert(it, range);
+
+		//lots of scattered edits cost more in driver calls than one bigger copy
+		if (m_dirty.size() > maxRanges) {
+			Range merged{ m_dirty.front().begin, m_dirty.back().end };
+			m_dirty.clear();
+			m_dirty.push_back(merged);
+		}
+	};
+
+
+	//sends the dirty ranges to the GPU, returns the number of elements uploaded
+	size_t upload() {
+		if (m_dirty.empty()) {
+			return 0;
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, ID);
+
+		if (m_data.size() > m_capacity) {
+			while (m_capacity < m_data.size()) {
+				m_capacity *= 2;
+			}
+			//orphans the old storage, so everything has to go up again
+			glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(T), NULL, GL_DYNAMIC_DRAW);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, m_data.size() * sizeof(T), m_data.data());
+			m_dirty.clear();
+			return m_data.size();
+		}
+
+		size_t uploaded = 0;
+		for (const Range& range : m_dirty) {
+			glBufferSubData(GL_ARRAY_BUFFER, range.begin * sizeof(T), (range.end - range.begin) * sizeof(T), m_data.data() + range.begin);
+			uploaded += range.end - range.begin;
+		}
+		m_dirty.clear();
+		return uploaded;
+	};
+
+
+
+private:
+	struct Range {
+		size_t begin;
+		size_t end;
+	};
+
+	static const size_t maxRanges = 32;
+
+	std::vector<T> m_data;
+	std::vector<Range> m_dirty; //sorted, non overlapping
+	size_t m_capacity;
+
+
+	//drops the parts of the dirty ranges that point past the end after a shrink
+	void clampDirty() {
+		size_t count = m_data.size();
+		while (!m_dirty.empty() && m_dirty.back().begin >= count) {
+			m_dirty.pop_back();
+		}
+		if (!m_dirty.empty()) {
+			m_dirty.back().end = std::min(m_dirty.back().end, count);
+		}
+	};
+};
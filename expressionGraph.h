@@ -0,0 +1,266 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "vectorKernels.h"
+
+enum Operation {
+	ADD,
+	SUBTRACT,
+	MULTIPLY, //by a scalar
+	DOT,
+	CROSS,
+	TRANSFORM //by a matrix, batches only (matrices aren't graph nodes)
+};
+
+inline const char* operationSymbol(Operation op) {
+	switch (op) {
+	case ADD: return "+";
+	case SUBTRACT: return "-";
+	case MULTIPLY: return "*";
+	case DOT: return ".";
+	case CROSS: return "x";
+	case TRANSFORM: return "M";
+	}
+	return "?";
+}
+
+using NodeId = uint32_t;
+const NodeId INVALID_NODE = 0xFFFFFFFFu;
+
+// Calculations as a DAG. Input nodes hold vectors, operation nodes combine earlier nodes:
+//   ADD       in0 + in1 + ...
+//   SUBTRACT  in0 - in1 - ...
+//   MULTIPLY  in0 * scalar
+//   DOT       in0 . in1  (scalar result, can't feed other nodes)
+//   CROSS     in0 x in1
+// Node ids are indices and never move, so they stay valid while nodes are added. Changing an input only marks the
+// nodes downstream of it dirty, evaluate() then recomputes just those, level by level, running each level's nodes of
+// one kind as a single SIMD batch.
+class ExpressionGraph {
+public:
+	NodeId addInput(const glm::vec3& value) {
+		Node node;
+		node.input = true;
+		node.value = value;
+		m_nodes.push_back(node);
+		return (NodeId)(m_nodes.size() - 1);
+	}
+
+	void setInput(NodeId id, const glm::vec3& value) {
+		if (!valid(id) || !m_nodes[id].input) {
+			return;
+		}
+		m_nodes[id].value = value;
+		for (NodeId dependent : m_nodes[id].dependents) {
+			markDirty(dependent);
+		}
+	}
+
+	//INVALID_NODE if the inputs don't fit the operation
+	NodeId addOperation(Operation op, const std::vector<NodeId>& inputs, float scalar = 1.0f) {
+		size_t needed = (op == DOT || op == CROSS) ? 2 : 1;
+		if (op == TRANSFORM || inputs.size() < needed || ((op == DOT || op == CROSS || op == MULTIPLY) && inputs.size() > needed)) {
+			return INVALID_NODE;
+		}
+		Node node;
+		node.op = op;
+		node.scalar = scalar;
+		node.inputs = inputs;
+		for (NodeId in : inputs) {
+			if (!valid(in) || m_nodes[in].scalarResult) {
+				return INVALID_NODE;
+			}
+			node.level = std::max(node.level, m_nodes[in].level + 1);
+		}
+		node.scalarResult = op == DOT;
+
+		NodeId id = (NodeId)m_nodes.size();
+		m_nodes.push_back(node);
+		for (NodeId in : inputs) {
+			std::vector<NodeId>& dependents = m_nodes[in].dependents;
+			if (std::find(dependents.begin(), dependents.end(), id) == dependents.end()) {
+				dependents.push_back(id);
+			}
+		}
+		markDirty(id);
+		return id;
+	}
+
+
+	//recomputes every dirty node, appends their ids to `changed`, false if nothing was dirty
+	bool evaluate(std::vector<NodeId>& changed) {
+		if (m_dirty.empty()) {
+			return false;
+		}
+		//inputs always sit on a lower level, so going up level by level respects the dependencies
+		std::sort(m_dirty.begin(), m_dirty.end(), [this](NodeId a, NodeId b) {
+			const Node& na = m_nodes[a];
+			const Node& nb = m_nodes[b];
+			if (na.level != nb.level) return na.level < nb.level;
+			if (na.op != nb.op) return na.op < nb.op;
+			if (na.scalar != nb.scalar) return na.scalar < nb.scalar;
+			return a < b;
+		});
+
+		size_t begin = 0;
+		while (begin < m_dirty.size()) {
+			const Node& first = m_nodes[m_dirty[begin]];
+			size_t end = begin + 1;
+			while (end < m_dirty.size()) {
+				const Node& next = m_nodes[m_dirty[end]];
+				if (next.level != first.level || next.op != first.op || next.scalar != first.scalar) {
+					break;
+				}
+				++end;
+			}
+			evaluateBatch(begin, end);
+			begin = end;
+		}
+
+		for (NodeId id : m_dirty) {
+			m_nodes[id].dirty = false;
+			changed.push_back(id);
+		}
+		m_dirty.clear();
+		return true;
+	}
+
+
+	bool valid(NodeId id) const { return id < m_nodes.size(); }
+	bool isInput(NodeId id) const { return m_nodes[id].input; }
+	bool isScalar(NodeId id) const { return m_nodes[id].scalarResult; }
+	bool isDirty(NodeId id) const { return m_nodes[id].dirty; }
+	Operation operation(NodeId id) const { return m_nodes[id].op; }
+	const std::vector<NodeId>& inputs(NodeId id) const { return m_nodes[id].inputs; }
+
+	glm::vec3 value(NodeId id) const { return m_nodes[id].value; }
+	float scalarValue(NodeId id) const { return m_nodes[id].scalarValue; }
+
+	size_t size() const { return m_nodes.size(); }
+
+	//every ADD / SUBTRACT node is marked dirty, all sums are redone in the new mode
+	void setReductionMode(kernels::ReductionMode mode) {
+		if (mode == m_reduction) {
+			return;
+		}
+		m_reduction = mode;
+		for (NodeId id = 0; id < m_nodes.size(); ++id) {
+			if (!m_nodes[id].input && (m_nodes[id].op == ADD || m_nodes[id].op == SUBTRACT)) {
+				markDirty(id);
+			}
+		}
+	}
+
+	kernels::ReductionMode reductionMode() const { return m_reduction; }
+
+	void clear() {
+		m_nodes.clear();
+		m_dirty.clear();
+	}
+
+
+
+private:
+	struct Node {
+		bool input = false;
+		Operation op = ADD;
+		float scalar = 1.0f;
+		std::vector<NodeId> inputs;
+		std::vector<NodeId> dependents;
+		int level = 0; //0 for inputs, 1 + the deepest input otherwise
+
+		glm::vec3 value = glm::vec3(0.0f);
+		float scalarValue = 0.0f;
+		bool scalarResult = false;
+		bool dirty = false;
+	};
+
+	std::vector<Node> m_nodes;
+	std::vector<NodeId> m_dirty;
+	kernels::ReductionMode m_reduction = kernels::ReductionMode::DETERMINISTIC;
+
+	//scratch batches
+	VectorArrays m_a;
+	VectorArrays m_b;
+	VectorArrays m_out;
+	std::vector<float> m_scalars;
+
+
+	//walks downstream and stops at nodes that are already dirty (everything below them is too)
+	void markDirty(NodeId id) {
+		std::vector<NodeId> stack{ id };
+		while (!stack.empty()) {
+			NodeId current = stack.back();
+			stack.pop_back();
+			Node& node = m_nodes[current];
+			if (node.dirty) {
+				continue;
+			}
+			node.dirty = true;
+			m_dirty.push_back(current);
+			stack.insert(stack.end(), node.dependents.begin(), node.dependents.end());
+		}
+	}
+
+
+	//m_dirty[begin, end) share level, op and scalar
+	void evaluateBatch(size_t begin, size_t end) {
+		const kernels::KernelTable& k = kernels::active();
+		Operation op = m_nodes[m_dirty[begin]].op;
+
+		if (op == ADD || op == SUBTRACT) {
+			//variable number of inputs, one reduction per node
+			for (size_t i = begin; i < end; ++i) {
+				Node& node = m_nodes[m_dirty[i]];
+				m_a.clear();
+				for (size_t in = (op == SUBTRACT ? 1 : 0); in < node.inputs.size(); ++in) {
+					m_a.push_back(m_nodes[node.inputs[in]].value);
+				}
+				glm::vec3 total = kernels::reduce(kernels::lanes(m_a), m_a.size(), m_reduction);
+				node.value = op == ADD ? total : m_nodes[node.inputs[0]].value - total;
+			}
+			return;
+		}
+
+		//fixed arity: one batch for the whole group
+		m_a.clear();
+		m_b.clear();
+		for (size_t i = begin; i < end; ++i) {
+			const Node& node = m_nodes[m_dirty[i]];
+			m_a.push_back(m_nodes[node.inputs[0]].value);
+			if (node.inputs.size() > 1) {
+				m_b.push_back(m_nodes[node.inputs[1]].value);
+			}
+		}
+		size_t n = m_a.size();
+		m_out.resize(n);
+		switch (op) {
+		case MULTIPLY:
+			k.scale(kernels::lanes(m_a), m_nodes[m_dirty[begin]].scalar, kernels::lanes(m_out), n);
+			break;
+		case CROSS:
+			k.cross(kernels::lanes(m_a), kernels::lanes(m_b), kernels::lanes(m_out), n);
+			break;
+		case DOT:
+			m_scalars.resize(n);
+			k.dot(kernels::lanes(m_a), kernels::lanes(m_b), m_scalars.data(), n);
+			break;
+		default:
+			break;
+		}
+		for (size_t i = begin; i < end; ++i) {
+			Node& node = m_nodes[m_dirty[i]];
+			if (op == DOT) {
+				node.scalarValue = m_scalars[i - begin];
+			}
+			else {
+				node.value = m_out.get(i - begin);
+			}
+		}
+	}
+};
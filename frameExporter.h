@@ -0,0 +1,178 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+
+#include "imageWriter.h"
+
+// Saves rendered frames without stalling the GPU.
+// capture() only queues a glReadPixels into one of a ring of pixel buffers; the copy finishes while the next
+// frames render, and the buffer is mapped when its slot comes round again. Encoding and disk writes happen on a
+// writer thread, so GPU rendering, readback and file output all overlap.
+class FrameExporter {
+public:
+	//pattern is a printf pattern for the frame number, e.g. "frames/frame_%05d.png" (.ppm writes PPM)
+	FrameExporter(int width, int height, const std::string& pattern, int ringSize = 3)
+		: m_width{ width }, m_height{ height }, m_pattern{ pattern }, m_slots(ringSize) {
+		size_t bytes = (size_t)width * height * 4;
+		for (Slot& slot : m_slots) {
+			glGenBuffers(1, &slot.PBO);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+			glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		m_writer = std::thread(&FrameExporter::writeLoop, this);
+	};
+
+	~FrameExporter() {
+		finish();
+		for (Slot& slot : m_slots) {
+			glDeleteBuffers(1, &slot.PBO);
+		}
+	};
+
+	FrameExporter(const FrameExporter&) = delete;
+	FrameExporter& operator=(const FrameExporter&) = delete;
+
+
+	//reads the currently bound read framebuffer (RGBA8, width x height) as frame number `frame`
+	void capture(int frame) {
+		Slot& slot = m_slots[m_next];
+		m_next = (m_next + 1) % m_slots.size();
+
+		//this slot still holds a frame from ringSize captures ago, by now its copy is (almost always) done
+		if (slot.pending) {
+			retire(slot);
+		}
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+		glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot.frame = frame;
+		slot.pending = true;
+	};
+
+
+	//flushes every outstanding frame and waits for the writer, safe to call twice
+	void finish() {
+		if (!m_writer.joinable()) {
+			return;
+		}
+		//oldest first so frames reach the writer in order
+		for (size_t i = 0; i < m_slots.size(); ++i) {
+			Slot& slot = m_slots[(m_next + i) % m_slots.size()];
+			if (slot.pending) {
+				retire(slot);
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_done = true;
+		}
+		m_wake.notify_all();
+		m_writer.join();
+	};
+
+	int written() const { return m_written; }
+	int failed() const { return m_failed; }
+
+
+
+private:
+	struct Slot {
+		unsigned int PBO = 0;
+		GLsync fence = 0;
+		int frame = 0;
+		bool pending = false;
+	};
+
+	struct Image {
+		int frame;
+		std::vector<uint8_t> pixels;
+	};
+
+	int m_width;
+	int m_height;
+	std::string m_pattern;
+
+	std::vector<Slot> m_slots;
+	size_t m_next = 0;
+
+	std::thread m_writer;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::deque<Image> m_queue;
+	bool m_done = false;
+
+	int m_written = 0; //only touched by the writer thread until finish() joins it
+	int m_failed = 0;
+
+
+	//waits for the copy into the slot's buffer, maps it and hands the pixels to the writer
+	void retire(Slot& slot) {
+		glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+		slot.pending = false;
+
+		Image image;
+		image.frame = slot.frame;
+		image.pixels.resize((size_t)m_width * m_height * 4);
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+		const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, image.pixels.size(), GL_MAP_READ_BIT);
+		if (mapped != NULL) {
+			std::copy((const uint8_t*)mapped, (const uint8_t*)mapped + image.pixels.size(), image.pixels.begin());
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queue.push_back(std::move(image));
+		}
+		m_wake.notify_one();
+	};
+
+
+	void writeLoop() {
+		while (true) {
+			Image image;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [this] { return m_done || !m_queue.empty(); });
+				if (m_queue.empty()) {
+					return; //done and drained
+				}
+				image = std::move(m_queue.front());
+				m_queue.pop_front();
+			}
+
+			char path[1024];
+			std::snprintf(path, sizeof(path), m_pattern.c_str(), image.frame);
+			std::string file(path);
+
+			bool ppm = file.size() >= 4 && file.compare(file.size() - 4, 4, ".ppm") == 0;
+			bool ok = ppm ? imageWriter::writePPM(file, m_width, m_height, image.pixels.data())
+				: imageWriter::writePNG(file, m_width, m_height, image.pixels.data());
+			if (ok) {
+				++m_written;
+			}
+			else {
+				++m_failed;
+				std::cout << "ERROR::EXPORT::WRITE_FAILED " << file << std::endl;
+			}
+		}
+	};
+};
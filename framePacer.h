@@ -0,0 +1,139 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+
+// Decides when the render loop draws its next frame, called where glfwPollEvents used to be.
+// In idle mode a frame is only drawn when something asks for one: input (the callbacks count events in the
+// counter given to the constructor), requestFrames() from the app, or background work reported by hasWork()
+// (drawn at pollInterval while it lasts, plus a few frames once it ends). Otherwise it sleeps in
+// glfwWaitEventsTimeout, waking every IDLE_CHECK to look at the background work, which can't wake glfw itself.
+// A frame cap sleeps the rest of the frame the same way, and vsync is glfwSwapInterval.
+// Frames skipped: how far the frames drawn per second stay under the cap (or the monitor rate).
+//   pacer.wait(window, [&] { return stream.queued() > 0 || importer.busy(); });
+class FramePacer {
+public:
+	static constexpr double IDLE_CHECK = 0.25; //seconds between looks at the background work while idle
+	static constexpr double CARET_BLINK = 0.4; //imgui blinks the text cursor, a frame this often while typing
+	static constexpr int SETTLE_FRAMES = 3; //imgui needs a couple of frames after input (hover, popups, layout)
+
+	bool idle = true;
+	int frameCap = 0; //frames per second at most, 0 = only vsync limits it
+	float pollInterval = 1.0f / 30.0f; //frame rate while background work is running and nothing else asks
+	bool textInput = false; //set every frame from io.WantTextInput
+
+	explicit FramePacer(const unsigned int& inputEvents)
+		: m_inputEvents{ inputEvents }, m_seenEvents{ inputEvents } {
+		const GLFWvidmode* mode = glfwGetPrimaryMonitor() != NULL ? glfwGetVideoMode(glfwGetPrimaryMonitor()) : NULL;
+		m_refreshRate = mode != NULL && mode->refreshRate > 0 ? mode->refreshRate : 60;
+		m_frameStart = m_statsStart = glfwGetTime();
+	};
+
+
+	void setVsync(bool on) {
+		m_vsync = on;
+		glfwSwapInterval(on ? 1 : 0);
+	};
+	bool vsync() const { return m_vsync; }
+
+	//the next frames have to be drawn: something changed, or keeps changing (call it every frame then)
+	void requestFrames(int frames = SETTLE_FRAMES) {
+		m_framesLeft = std::max(m_framesLeft, frames);
+	};
+
+
+	//after the swap: handles the pending events and returns when the next frame should be drawn
+	template <typename HasWork>
+	void wait(GLFWwindow* window, HasWork hasWork) {
+		double waitStart = glfwGetTime();
+		if (frameCap > 0) {
+			sleepUntil(m_frameStart + 1.0 / frameCap);
+		}
+		glfwPollEvents();
+
+		if (m_framesLeft > 0) {
+			--m_framesLeft;
+		}
+		if (idle) {
+			double lastDraw = m_frameStart;
+			while (!glfwWindowShouldClose(window)) {
+				if (m_inputEvents != m_seenEvents) {
+					m_seenEvents = m_inputEvents;
+					requestFrames();
+				}
+				bool work = hasWork();
+				if (work != m_working) {
+					//started or finished, either way it shows
+					m_working = work;
+					requestFrames();
+				}
+				double now = glfwGetTime();
+				if (m_framesLeft > 0 || (work && now - lastDraw >= pollInterval) || (textInput && now - lastDraw >= CARET_BLINK)) {
+					break;
+				}
+				double timeout = IDLE_CHECK;
+				if (work) {
+					timeout = std::min(timeout, lastDraw + pollInterval - now);
+				}
+				if (textInput) {
+					timeout = std::min(timeout, lastDraw + CARET_BLINK - now);
+				}
+				glfwWaitEventsTimeout(std::max(timeout, 0.001));
+			}
+		}
+		m_seenEvents = m_inputEvents;
+
+		double now = glfwGetTime();
+		countFrame(now, now - waitStart);
+		m_frameStart = now;
+	};
+
+
+	//over the last second
+	float fps() const { return m_fps; }
+	float skippedPerSecond() const { return m_skipped; }
+	float asleep() const { return m_asleep; } //share of the time spent waiting, 0..1
+
+
+
+private:
+	const unsigned int& m_inputEvents;
+	unsigned int m_seenEvents;
+	int m_framesLeft = SETTLE_FRAMES;
+	bool m_working = false;
+	bool m_vsync = true;
+	int m_refreshRate = 60;
+	double m_frameStart = 0.0;
+
+	double m_statsStart = 0.0;
+	double m_waited = 0.0;
+	int m_frames = 0;
+	float m_fps = 0.0f;
+	float m_skipped = 0.0f;
+	float m_asleep = 0.0f;
+
+
+	//events still get handled while sleeping, they just don't end the sleep
+	void sleepUntil(double time) {
+		for (double now = glfwGetTime(); now < time; now = glfwGetTime()) {
+			glfwWaitEventsTimeout(time - now);
+		}
+	};
+
+	void countFrame(double now, double waited) {
+		++m_frames;
+		m_waited += waited;
+		double elapsed = now - m_statsStart;
+		if (elapsed < 1.0) {
+			return;
+		}
+		int rate = frameCap > 0 ? (m_vsync ? std::min(frameCap, m_refreshRate) : frameCap) : m_refreshRate;
+		m_fps = (float)(m_frames / elapsed);
+		m_skipped = std::max((float)rate - m_fps, 0.0f);
+		m_asleep = (float)std::min(m_waited / elapsed, 1.0);
+		m_frames = 0;
+		m_waited = 0.0;
+		m_statsStart = now;
+	};
+};
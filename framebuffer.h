@@ -0,0 +1,65 @@
+#pragma once
+
+#include <iostream>
+#include <glad/glad.h>
+
+// Offscreen render target: one color renderbuffer + a depth renderbuffer.
+// colorFormat is the sized internal format, GL_RGBA8 for images.
+class Framebuffer {
+public:
+	unsigned int FBO;
+
+	Framebuffer(int width, int height, GLenum colorFormat = GL_RGBA8)
+		: m_width{ width }, m_height{ height } {
+		glGenFramebuffers(1, &FBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+		glGenRenderbuffers(1, &colorRBO);
+		glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, colorFormat, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+
+		glGenRenderbuffers(1, &depthRBO);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "ERROR::FRAMEBUFFER::NOT_COMPLETE" << std::endl;
+		}
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	};
+
+	~Framebuffer() {
+		glDeleteRenderbuffers(1, &colorRBO);
+		glDeleteRenderbuffers(1, &depthRBO);
+		glDeleteFramebuffers(1, &FBO);
+	};
+
+	Framebuffer(const Framebuffer&) = delete;
+	Framebuffer& operator=(const Framebuffer&) = delete;
+
+
+	//draw + read target and viewport in one go
+	void bind() const {
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glViewport(0, 0, m_width, m_height);
+	};
+
+	static void unbind() {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	};
+
+	int width() const { return m_width; }
+	int height() const { return m_height; }
+
+
+
+private:
+	unsigned int colorRBO;
+	unsigned int depthRBO;
+
+	int m_width;
+	int m_height;
+};
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <iostream>
+
+#include "arrowRenderer.h"
+#include "expressionGraph.h"
+
+// Per-vector calculator operations on the GPU, straight from one arrow instance buffer into another with
+// transform feedback (core since GL 3.0, no compute shaders needed):
+//   MULTIPLY   direction * scalar
+//   TRANSFORM  matrix * (direction, 1), affine like kernels::transform
+//   CROSS      direction x other
+// A vertex-only program reads every ArrowInstance as a point and writes the result back out with the exact
+// same 28 byte layout, so the vectors never come back to the CPU. The source and destination buffers must
+// differ (transform feedback can't write the buffer it reads).
+// ADD / SUBTRACT / DOT don't map to it (reductions and scalars) and stay on the CPU, as does everything when
+// available() is false: the program didn't build, or the self test against the CPU kernels failed.
+// PLANE_GPU=0 turns it off; LIBGL_ALWAYS_SOFTWARE=1 runs it on Mesa's llvmpipe.
+class GpuTransform {
+public:
+	GpuTransform() {
+		const char* env = std::getenv("PLANE_GPU");
+		if (env != nullptr && std::strcmp(env, "0") == 0) {
+			std::cout << "GpuTransform off (PLANE_GPU=0)\n";
+			return;
+		}
+		if (!buildProgram()) {
+			return;
+		}
+		glGenVertexArrays(1, &VAO);
+		m_available = selfTest();
+		std::cout << "GpuTransform " << (m_available ? "ready" : "failed its self test, using the cpu") << "\n";
+	};
+
+	~GpuTransform() {
+		if (VAO != 0) {
+			glDeleteVertexArrays(1, &VAO);
+		}
+		if (program != 0) {
+			glDeleteProgram(program);
+		}
+	};
+
+	GpuTransform(const GpuTransform&) = delete;
+	GpuTransform& operator=(const GpuTransform&) = delete;
+
+
+	bool available() const { return m_available; }
+
+	static bool supports(Operation op) {
+		return op == MULTIPLY || op == TRANSFORM || op == CROSS;
+	}
+
+
+	//dst[i] = op(src[i]) for the first `count` instances, every output gets `color`
+	//dst must already have room for count instances (DynamicBuffer::resizeDeviceOnly)
+	bool apply(unsigned int srcBuffer, unsigned int dstBuffer, size_t count, Operation op,
+		float scalar, const glm::mat4& matrix, const glm::vec3& other, uint32_t color) {
+		if (!m_available || !supports(op) || srcBuffer == dstBuffer) {
+			return false;
+		}
+		if (count == 0) {
+			return true;
+		}
+		run(srcBuffer, dstBuffer, count, op, scalar, matrix, other, color);
+		return true;
+	};
+
+
+
+private:
+	unsigned int program = 0;
+	unsigned int VAO = 0;
+	bool m_available = false;
+
+	int uOperation = -1;
+	int uScalar = -1;
+	int uMatrix = -1;
+	int uOther = -1;
+	int uColor = -1;
+
+	//matches ArrowInstance: 3 + 3 floats and the packed color, interleaved
+	static constexpr const char* vertexSource = R"(#version 330 core
+layout (location = 0) in vec3 aOrigin;
+layout (location = 1) in vec3 aDirection;
+layout (location = 2) in uint aColor;
+
+uniform int operation; // 0 multiply, 1 transform, 2 cross
+uniform float scalar;
+uniform mat4 matrix;
+uniform vec3 other;
+uniform uint color;
+
+out vec3 outOrigin;
+out vec3 outDirection;
+flat out uint outColor;
+
+void main()
+{
+   vec3 d = aDirection;
+   if (operation == 0) {
+      d = d * scalar;
+   }
+   else if (operation == 1) {
+      d = (matrix * vec4(d, 1.0)).xyz;
+   }
+   else {
+      d = cross(d, other);
+   }
+   outOrigin = aOrigin;
+   outDirection = d;
+   outColor = color;
+}
+)";
+
+
+	bool buildProgram() {
+		unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(vertex, 1, &vertexSource, NULL);
+		glCompileShader(vertex);
+		int success;
+		char infoLog[1024];
+		glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+		if (!success) {
+			glGetShaderInfoLog(vertex, 1024, NULL, infoLog);
+			std::cout << "ERROR::GPU_TRANSFORM::COMPILATION_FAILED\n" << infoLog << std::endl;
+			glDeleteShader(vertex);
+			return false;
+		}
+
+		program = glCreateProgram();
+		glAttachShader(program, vertex);
+		//has to be set before linking
+		const char* varyings[] = { "outOrigin", "outDirection", "outColor" };
+		glTransformFeedbackVaryings(program, 3, varyings, GL_INTERLEAVED_ATTRIBS);
+		glLinkProgram(program);
+		glDeleteShader(vertex);
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			glGetProgramInfoLog(program, 1024, NULL, infoLog);
+			std::cout << "ERROR::GPU_TRANSFORM::LINKING_FAILED\n" << infoLog << std::endl;
+			glDeleteProgram(program);
+			program = 0;
+			return false;
+		}
+
+		uOperation = glGetUniformLocation(program, "operation");
+		uScalar = glGetUniformLocation(program, "scalar");
+		uMatrix = glGetUniformLocation(program, "matrix");
+		uOther = glGetUniformLocation(program, "other");
+		uColor = glGetUniformLocation(program, "color");
+		return true;
+	};
+
+
+	void run(unsigned int srcBuffer, unsigned int dstBuffer, size_t count, Operation op,
+		float scalar, const glm::mat4& matrix, const glm::vec3& other, uint32_t color) {
+		glUseProgram(program);
+		glUniform1i(uOperation, op == MULTIPLY ? 0 : op == TRANSFORM ? 1 : 2);
+		glUniform1f(uScalar, scalar);
+		glUniformMatrix4fv(uMatrix, 1, GL_FALSE, glm::value_ptr(matrix));
+		glUniform3f(uOther, other.x, other.y, other.z);
+		glUniform1ui(uColor, color);
+
+		//the instance attributes, read once per point instead of once per instance
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, srcBuffer);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ArrowInstance), (void*)offsetof(ArrowInstance, origin));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ArrowInstance), (void*)offsetof(ArrowInstance, direction));
+		glEnableVertexAttribArray(1);
+		glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(ArrowInstance), (void*)offsetof(ArrowInstance, color));
+		glEnableVertexAttribArray(2);
+
+		glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, dstBuffer, 0, (GLsizeiptr)(count * sizeof(ArrowInstance)));
+		glEnable(GL_RASTERIZER_DISCARD);
+		glBeginTransformFeedback(GL_POINTS);
+		glDrawArrays(GL_POINTS, 0, (GLsizei)count);
+		glEndTransformFeedback();
+		glDisable(GL_RASTERIZER_DISCARD);
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glUseProgram(0);
+	};
+
+
+	//a few vectors through every operation, read back and compared with the CPU kernels
+	//(catches drivers that build the program but get the capture wrong)
+	bool selfTest() {
+		while (glGetError() != GL_NO_ERROR) {
+		}
+		std::vector<ArrowInstance> input;
+		for (int i = 0; i < 9; ++i) {
+			input.push_back(ArrowInstance{ glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.1f * i, 1.0f - 0.2f * i, 0.5f), 0x11223344u });
+		}
+		glm::mat4 matrix(1.0f);
+		matrix[0][1] = 0.5f;
+		matrix[2][0] = -2.0f;
+		matrix[3] = glm::vec4(0.25f, 0.0f, -1.0f, 1.0f);
+		glm::vec3 other(0.3f, -0.7f, 0.2f);
+		size_t bytes = input.size() * sizeof(ArrowInstance);
+
+		unsigned int buffers[2];
+		glGenBuffers(2, buffers);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+		glBufferData(GL_ARRAY_BUFFER, bytes, input.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+		glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_DYNAMIC_COPY);
+
+		bool passed = true;
+		std::vector<ArrowInstance> output(input.size());
+		for (Operation op : { MULTIPLY, TRANSFORM, CROSS }) {
+			run(buffers[0], buffers[1], input.size(), op, 2.0f, matrix, other, 0xAABBCCDDu);
+			glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+			glGetBufferSubData(GL_ARRAY_BUFFER, 0, bytes, output.data());
+			for (size_t i = 0; i < input.size(); ++i) {
+				glm::vec3 d = input[i].direction;
+				glm::vec3 expected = op == MULTIPLY ? d * 2.0f : op == TRANSFORM ? glm::vec3(matrix * glm::vec4(d, 1.0f)) : glm::cross(d, other);
+				glm::vec3 error = output[i].direction - expected;
+				if (std::fabs(error.x) + std::fabs(error.y) + std::fabs(error.z) > 1e-4f || output[i].color != 0xAABBCCDDu) {
+					passed = false;
+				}
+			}
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glDeleteBuffers(2, buffers);
+		return passed && glGetError() == GL_NO_ERROR;
+	};
+};
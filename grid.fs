@@ -0,0 +1,73 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 planePos;
+in vec3 viewPos;
+flat in vec2 quadCenter;
+flat in float quadExtent;
+flat in float cameraHeight;
+
+uniform float spacing;
+uniform int majorEvery;
+uniform float lineWidth;    // pixels
+uniform float fadeDistance;
+
+uniform bool adaptive;
+
+const float minorAlpha = 0.35;
+const float majorAlpha = 0.7;
+
+
+// 1 on a line of the given cell size, 0 away from it, anti-aliased over about one pixel
+// lines whose cells shrink to a few pixels fade out instead of turning into moire
+float gridLine(vec2 pos, float cell, float width)
+{
+   vec2 coord = pos / cell;
+   vec2 deriv = max(fwidth(coord), vec2(1e-6));
+   vec2 dist = abs(fract(coord - 0.5) - 0.5) / deriv; // distance to the closest line in pixels
+   float d = min(dist.x, dist.y);
+   float density = 1.0 - smoothstep(0.15, 0.4, max(deriv.x, deriv.y));
+   return (1.0 - clamp(d - 0.5 * width + 0.5, 0.0, 1.0)) * density;
+}
+
+
+void main()
+{
+   float lines;
+   float fade;
+   if (adaptive) {
+      // three power of ten levels around the camera distance, the finest one fades out
+      // as we move away so the switch to the next level never pops
+      float lod = log(cameraHeight) / log(10.0) - 1.0;
+      float level = floor(lod);
+      float t = lod - level;
+      float cell = pow(10.0, level);
+
+      float fine = gridLine(planePos, cell, lineWidth) * minorAlpha * (1.0 - t);
+      float mid = gridLine(planePos, cell * 10.0, lineWidth) * mix(majorAlpha, minorAlpha, t);
+      float coarse = gridLine(planePos, cell * 100.0, lineWidth * 1.5) * majorAlpha;
+      lines = max(max(fine, mid), coarse);
+
+      fade = 1.0 - smoothstep(0.3, 1.0, length(planePos - quadCenter) / quadExtent);
+   }
+   else {
+      float minor = gridLine(planePos, spacing, lineWidth);
+      float major = gridLine(planePos, spacing * float(majorEvery), lineWidth * 1.5);
+      lines = max(minor * minorAlpha, major * majorAlpha);
+
+      // fade with distance from the camera and towards the border of the plane
+      vec2 border = abs(planePos) / quadExtent;
+      fade = (1.0 - smoothstep(0.5 * fadeDistance, fadeDistance, length(viewPos)))
+           * (1.0 - smoothstep(0.9, 1.0, max(border.x, border.y)));
+   }
+
+   // the two axes lying in this plane
+   vec2 axisDist = abs(planePos) / max(fwidth(planePos), vec2(1e-6));
+   float axis = 1.0 - clamp(min(axisDist.x, axisDist.y) - lineWidth + 0.5, 0.0, 1.0);
+
+   float alpha = max(lines, axis) * fade;
+   if (alpha < 0.003) {
+      discard;
+   }
+   FragColor = vec4(1.0, 1.0, 1.0, alpha);
+}
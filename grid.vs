@@ -0,0 +1,86 @@
+#version 330 core
+layout (location = 0) in vec2 aQuad; // unit quad corner, -1..1
+
+
+uniform mat4 model;
+layout (std140) uniform Camera
+{
+   mat4 view;
+   mat4 projection;
+   vec4 cameraPosition;
+};
+
+uniform int planeMask; // bit 0 = XY, bit 1 = XZ, bit 2 = YZ
+uniform float extent;
+
+uniform bool adaptive;      // follow the camera and pick the spacing from its distance
+uniform vec3 cameraLocal;   // camera position in grid (model) space
+uniform float horizon;      // adaptive quad half size, in multiples of the camera distance
+uniform float maxExtent;    // keep the adaptive quad inside the far plane
+
+out vec2 planePos; // position on the plane in world units
+out vec3 viewPos;
+flat out vec2 quadCenter;
+flat out float quadExtent;
+flat out float cameraHeight; // how far the camera is from this plane
+
+
+
+void main()
+{
+   // one instance per plane
+   int plane = gl_InstanceID;
+
+   // camera in this plane's 2D coordinates, and its distance along the plane normal
+   vec2 cameraOnPlane;
+   float height;
+   if (plane == 0) {
+      cameraOnPlane = cameraLocal.xy;
+      height = abs(cameraLocal.z);
+   }
+   else if (plane == 1) {
+      cameraOnPlane = cameraLocal.xz;
+      height = abs(cameraLocal.y);
+   }
+   else {
+      cameraOnPlane = cameraLocal.zy;
+      height = abs(cameraLocal.x);
+   }
+   // at grazing angles the plane distance says little about what is on screen
+   height = max(height, 0.15 * length(cameraLocal));
+   cameraHeight = height;
+
+   if (adaptive) {
+      quadCenter = cameraOnPlane;
+      quadExtent = min(max(height * horizon, 1e-3), maxExtent);
+   }
+   else {
+      quadCenter = vec2(0.0);
+      quadExtent = extent;
+   }
+
+   vec2 p = quadCenter + aQuad * quadExtent;
+   planePos = p;
+
+   vec3 pos;
+   if (plane == 0) {
+      pos = vec3(p.x, p.y, 0.0);
+   }
+   else if (plane == 1) {
+      pos = vec3(p.x, 0.0, p.y);
+   }
+   else {
+      pos = vec3(0.0, p.y, p.x);
+   }
+
+   // disabled planes collapse into a single point outside the view
+   if ((planeMask & (1 << plane)) == 0) {
+      viewPos = vec3(0.0);
+      gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+      return;
+   }
+
+   vec4 vp = view * model * vec4(pos, 1.0);
+   viewPos = vp.xyz;
+   gl_Position = projection * vp;
+}
@@ -1,47 +1,143 @@
 #pragma once
 
 #include <vector>
+#include <cmath>
+#include <algorithm>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include "shader.h"
+#include "vertex.h"
+
+enum class GridMode {
+	LINES,      //CPU generated GL_LINES, cost grows with slices
+	PROCEDURAL  //one quad per plane, lines computed in grid.fs
+};
 
 class GridRenderer {
 public:
+	//PROCEDURAL settings, these are just uniforms so changing them costs nothing
+	float spacing = 0.1f;    //minor cell size
+	int majorEvery = 5;      //every n-th minor line is a major line
+	float extent;            //half size of each plane
+	float lineWidth = 1.0f;  //in pixels
+	float fadeDistance = 3.0f; //lines fade out towards this distance from the camera
+
+	//adaptive LOD: the planes follow the camera and the spacing is picked from its distance in powers of ten
+	bool adaptive = true;
+	float horizon = 40.0f;   //quad half size in multiples of the camera distance
+	float maxExtent = 90.0f; //stay inside the far plane
+
 	GridRenderer(int slices, float edge)
-		: m_edge{ edge }, m_slices{ slices } {
+		: extent{ edge }, m_edge{ edge }, m_slices{ slices } {
 		generateGrid(slices, edge);
 		setupBuffers();
+		setupQuad();
 	};
 
 	~GridRenderer() {
 		glDeleteVertexArrays(1, &VAO);
 		glDeleteBuffers(1, &VBO);
-		glDeleteBuffers(1, &colorVBO);
+		glDeleteVertexArrays(1, &quadVAO);
+		glDeleteBuffers(1, &quadVBO);
 	}; //destructor cleans up VAO/VBO
 
-	void draw(const Shader& shader) {
-		glLineWidth(1.0f);
-		glBindVertexArray(VAO);
-		glDrawArrays(GL_LINES, 0, gridLines.size());
+	//call once per frame before draw so the adaptive grid knows where the camera is
+	void setCamera(const glm::mat4& model, const glm::mat4& view) {
+		glm::vec4 camera = glm::inverse(view * model) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		m_cameraLocal = glm::vec3(camera) / camera.w;
+	};
+
+	//finest spacing the adaptive grid is showing on the XY plane right now (same math as grid.vs/grid.fs)
+	float levelSpacing() const {
+		float height = std::max(std::abs(m_cameraLocal.z), 0.15f * glm::length(m_cameraLocal));
+		return std::pow(10.0f, std::floor(std::log10(std::max(height, 1e-6f)) - 1.0f));
+	};
+
+	//lineShader draws the LINES mode, gridShader (grid.vs/grid.fs) the PROCEDURAL one
+	//both need model/view/projection set already
+	void draw(Shader& lineShader, Shader& gridShader) {
+		if (m_mode == GridMode::LINES) {
+			lineShader.use();
+			glLineWidth(1.0f);
+			glBindVertexArray(VAO);
+			glDrawArrays(GL_LINES, 0, gridLines.size());
+			return;
+		}
+
+		gridShader.use();
+		gridShader.setInt(uPlaneMask, planeMask());
+		gridShader.setFloat(uExtent, extent);
+		gridShader.setFloat(uSpacing, spacing);
+		gridShader.setInt(uMajorEvery, majorEvery);
+		gridShader.setFloat(uLineWidth, lineWidth);
+		gridShader.setFloat(uFadeDistance, fadeDistance);
+		gridShader.setBool(uAdaptive, adaptive);
+		gridShader.setFloat(uHorizon, horizon);
+		gridShader.setFloat(uMaxExtent, maxExtent);
+		gridShader.setVec3(uCameraLocal, m_cameraLocal);
+
+		//the planes are see-through, so blend and keep them out of the depth buffer
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glDepthMask(GL_FALSE);
+
+		//instance 0 = XY, 1 = XZ, 2 = YZ, disabled planes collapse in the vertex shader
+		glBindVertexArray(quadVAO);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, 3);
+		glBindVertexArray(0);
+
+		glDepthMask(GL_TRUE);
+		glDisable(GL_BLEND);
 	};
 
 	void enableXZ(bool enable) {
 		m_xzEnabled = enable;
-		generateGrid(m_slices, m_edge);
-		updateBuffers();
+		if (m_mode == GridMode::LINES) {
+			generateGrid(m_slices, m_edge);
+			updateBuffers();
+		}
 	};
 	void enableYZ(bool enable) {
 		m_yzEnabled = enable;
-		generateGrid(m_slices, m_edge);
-		updateBuffers();
+		if (m_mode == GridMode::LINES) {
+			generateGrid(m_slices, m_edge);
+			updateBuffers();
+		}
 	};
 
+	void setMode(GridMode mode) {
+		if (mode == GridMode::LINES && m_mode != GridMode::LINES) {
+			//plane toggles don't touch the lines while procedural, so catch up here
+			generateGrid(m_slices, m_edge);
+			updateBuffers();
+		}
+		m_mode = mode;
+	};
+	GridMode mode() const { return m_mode; }
+
 
 
 private:
+	//grid.vs / grid.fs, hashed at compile time (see shader.h)
+	static constexpr UniformId uPlaneMask{ "planeMask" };
+	static constexpr UniformId uExtent{ "extent" };
+	static constexpr UniformId uSpacing{ "spacing" };
+	static constexpr UniformId uMajorEvery{ "majorEvery" };
+	static constexpr UniformId uLineWidth{ "lineWidth" };
+	static constexpr UniformId uFadeDistance{ "fadeDistance" };
+	static constexpr UniformId uAdaptive{ "adaptive" };
+	static constexpr UniformId uHorizon{ "horizon" };
+	static constexpr UniformId uMaxExtent{ "maxExtent" };
+	static constexpr UniformId uCameraLocal{ "cameraLocal" };
+
 	unsigned int VAO;
 	unsigned int VBO;
-	unsigned int colorVBO;
+
+	unsigned int quadVAO;
+	unsigned int quadVBO;
+
+	GridMode m_mode = GridMode::PROCEDURAL;
+	glm::vec3 m_cameraLocal = glm::vec3(0.0f, 0.0f, 1.0f);
 
 	size_t numLines;
 
@@ -49,16 +145,16 @@ private:
 	float m_edge;
 	int m_slices;
 
-	float m_xzEnabled = false;
-	float m_yzEnabled = false;
+	bool m_xzEnabled = false;
+	bool m_yzEnabled = false;
+
+	std::vector<Vertex> gridLines;
 
-	std::vector<glm::vec3> gridLines;
-	std::vector<glm::vec3> gridColors;
+	const uint32_t gridColor = packColor(glm::vec3(1.0f, 1.0f, 1.0f)); // white color for all lines
 
 
 	void generateGrid(int slices, float edge) {
 		gridLines.clear();
-		gridColors.clear();
 
 		float pos = -edge;
 		for (int i = 0; i <= slices; ++i) {
@@ -66,16 +162,16 @@ private:
 
 			//(XY PLANE)
 			//vertical lines
-			gridLines.push_back(glm::vec3(x, edge, 0.0f)); //top point
-			gridLines.push_back(glm::vec3(x, -edge, 0.0f)); //bottom point
+			gridLines.push_back({ glm::vec3(x, edge, 0.0f), gridColor }); //top point
+			gridLines.push_back({ glm::vec3(x, -edge, 0.0f), gridColor }); //bottom point
 
 			//horizontal lines
-			gridLines.push_back(glm::vec3(-edge, x, 0.0f)); //left point
-			gridLines.push_back(glm::vec3(edge, x, 0.0f)); //right point
+			gridLines.push_back({ glm::vec3(-edge, x, 0.0f), gridColor }); //left point
+			gridLines.push_back({ glm::vec3(edge, x, 0.0f), gridColor }); //right point
 
 			//(XZ PLANE)
-			gridLines.push_back(glm::vec3(0.0f, 0.0f, edge)); //top point
-			gridLines.push_back(glm::vec3(0.0f, 0.0f, -edge)); //bottom point
+			gridLines.push_back({ glm::vec3(0.0f, 0.0f, edge), gridColor }); //top point
+			gridLines.push_back({ glm::vec3(0.0f, 0.0f, -edge), gridColor }); //bottom point
 
 
 			if (m_xzEnabled) {
@@ -90,10 +186,6 @@ private:
 			pos += 0.1;
 		}
 
-		for (size_t i = 0; i < gridLines.size(); ++i) {
-			gridColors.push_back(glm::vec3(1.0f, 1.0f, 1.0f)); // white color for all lines
-		}
-
 	};
 
 
@@ -105,12 +197,12 @@ private:
 			float x = pos;
 			//(XZ PLANE)
 			//vertical lines
-			gridLines.push_back(glm::vec3(x, 0.0f, m_edge)); //top point
-			gridLines.push_back(glm::vec3(x, 0.0f, -m_edge)); //bottom point
+			gridLines.push_back({ glm::vec3(x, 0.0f, m_edge), gridColor }); //top point
+			gridLines.push_back({ glm::vec3(x, 0.0f, -m_edge), gridColor }); //bottom point
 
 			//horizontal lines
-			gridLines.push_back(glm::vec3(-m_edge, 0.0f, x)); //left point
-			gridLines.push_back(glm::vec3(m_edge, 0.0f, x)); //right point
+			gridLines.push_back({ glm::vec3(-m_edge, 0.0f, x), gridColor }); //left point
+			gridLines.push_back({ glm::vec3(m_edge, 0.0f, x), gridColor }); //right point
 
 			pos += 0.1;
 		}
@@ -126,12 +218,12 @@ private:
 			float x = pos;
 			//(YZ PLANE)
 			//vertical lines
-			gridLines.push_back(glm::vec3(0.0f, m_edge, x)); //top point
-			gridLines.push_back(glm::vec3(0.0f, -m_edge, x)); //bottom point
+			gridLines.push_back({ glm::vec3(0.0f, m_edge, x), gridColor }); //top point
+			gridLines.push_back({ glm::vec3(0.0f, -m_edge, x), gridColor }); //bottom point
 
 			//horizontal lines
-			gridLines.push_back(glm::vec3(0.0f, x, -m_edge)); //left point
-			gridLines.push_back(glm::vec3(0.0f, x, m_edge)); //right point
+			gridLines.push_back({ glm::vec3(0.0f, x, -m_edge), gridColor }); //left point
+			gridLines.push_back({ glm::vec3(0.0f, x, m_edge), gridColor }); //right point
 
 			pos += 0.1;
 		}
@@ -151,38 +243,52 @@ private:
 		// VAO will then rememver the following:
 		glBindBuffer(GL_ARRAY_BUFFER, VBO); //give array buffer the id && any calls to GL_ARRAY_BUFFER will change VBO
 		// this just copies our vertices to the bound buffer
-		glBufferData(GL_ARRAY_BUFFER, gridLines.size() * sizeof(glm::vec3), gridLines.data(), GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, gridLines.size() * sizeof(Vertex), gridLines.data(), GL_STATIC_DRAW);
 
 		// NOTE:  up to this point OpenGL still doesn't know how to connect our vertices to the vertex shader and how it should interpret data in memory (buffer remember? VB0?)
 
-		//HOW TO INTERPRET DATA:
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0); // Connects VBO and shaders too
-		glEnableVertexAttribArray(0);
+		//HOW TO INTERPRET DATA: position + packed color interleaved in the one VBO
+		Vertex::setupAttributes(); // Connects VBO and shaders too
+
+		glBindVertexArray(0);
+	};
+
 
 
-		glGenBuffers(1, &colorVBO);
 
-		glBindBuffer(GL_ARRAY_BUFFER, colorVBO);
-		glBufferData(GL_ARRAY_BUFFER, gridColors.size() * sizeof(glm::vec3), gridColors.data(), GL_STATIC_DRAW);
+	//unit quad in plane space, grid.vs scales it by extent and places it on the plane
+	void setupQuad() {
+		const float quad[] = {
+			-1.0f, -1.0f,
+			 1.0f, -1.0f,
+			-1.0f,  1.0f,
+			 1.0f,  1.0f,
+		};
 
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(1);
+		glGenBuffers(1, &quadVBO);
+		glGenVertexArrays(1, &quadVAO);
+		glBindVertexArray(quadVAO);
+
+		glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(0);
 
 		glBindVertexArray(0);
 	};
 
 
+	int planeMask() const {
+		return 1 | (m_xzEnabled ? 2 : 0) | (m_yzEnabled ? 4 : 0);
+	};
+
+
 
 
 	void updateBuffers() {
 		glBindBuffer(GL_ARRAY_BUFFER, VBO); //give array buffer the id && any calls to GL_ARRAY_BUFFER will change VBO
 		// this just copies our vertices to the bound buffer
-		glBufferData(GL_ARRAY_BUFFER, gridLines.size() * sizeof(glm::vec3), gridLines.data(), GL_STATIC_DRAW);
-
-
-		glBindBuffer(GL_ARRAY_BUFFER, colorVBO);
-		glBufferData(GL_ARRAY_BUFFER, gridColors.size() * sizeof(glm::vec3), gridColors.data(), GL_STATIC_DRAW);
-
+		glBufferData(GL_ARRAY_BUFFER, gridLines.size() * sizeof(Vertex), gridLines.data(), GL_STATIC_DRAW);
 	}
 	
 };
\ No newline at end of file
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+
+#include "vectorFile.h"
+#include "vectorImporter.h"
+
+// Batch export without a display:
+//   plane --headless --size 1920x1080 --frames 360 --out frames/frame_%05d.png --vectors field.txt
+// renders the grid and vectors into an offscreen framebuffer, orbiting the camera once over all frames
+// (the flags are parsed with the rest in appOptions.h).
+// On GLFW 3.4 it runs on the null platform with an EGL or OSMesa context, so Mesa's software rasterizer
+// (llvmpipe, e.g. LIBGL_ALWAYS_SOFTWARE=1) works on plain CI boxes; older GLFW falls back to a hidden window.
+struct HeadlessOptions {
+	bool enabled = false;
+	int width = 1280;
+	int height = 720;
+	int frames = 1;
+	std::string outPattern = "frame_%05d.png"; //.ppm for PPM
+};
+
+
+//the pattern goes to snprintf with the frame number: exactly one %d (or %0Nd), any other % only as %%
+inline bool validOutPattern(const std::string& pattern) {
+	int frameFields = 0;
+	for (size_t i = 0; i < pattern.size(); ++i) {
+		if (pattern[i] != '%') {
+			continue;
+		}
+		++i;
+		if (i < pattern.size() && pattern[i] == '%') {
+			continue;
+		}
+		if (i < pattern.size() && pattern[i] == '0') {
+			++i;
+		}
+		while (i < pattern.size() && pattern[i] >= '0' && pattern[i] <= '9') {
+			++i;
+		}
+		if (i >= pattern.size() || pattern[i] != 'd') {
+			return false;
+		}
+		++frameFields;
+	}
+	return frameFields == 1;
+}
+
+
+inline void headlessContextHints() {
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+}
+
+//initializes glfw and returns a window we never show, only its context is used (nullptr if nothing worked)
+inline GLFWwindow* createHeadlessWindow() {
+#ifdef GLFW_PLATFORM_NULL
+	//GLFW 3.4+: no display server at all, the context comes straight from EGL or OSMesa
+	const int contextApis[] = { GLFW_EGL_CONTEXT_API, GLFW_OSMESA_CONTEXT_API };
+	for (int api : contextApis) {
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+		if (!glfwInit()) {
+			break;
+		}
+		headlessContextHints();
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, api);
+		GLFWwindow* window = glfwCreateWindow(16, 16, "plane headless", NULL, NULL);
+		if (window != NULL) {
+			return window;
+		}
+		glfwTerminate();
+	}
+	glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+#endif
+
+	//older GLFW: a hidden window on whatever display exists (xvfb-run works on servers)
+	if (!glfwInit()) {
+		return NULL;
+	}
+	headlessContextHints();
+	GLFWwindow* window = glfwCreateWindow(16, 16, "plane headless", NULL, NULL);
+	if (window == NULL) {
+		glfwTerminate();
+	}
+	return window;
+}
+
+
+//"x y z" or "x y z r g b" per line (see parseVectorLine), '#' starts a comment. Colors default to `color`
+//parsed right here, the interactive app uses VectorImporter to do it in the background
+inline bool loadVectorText(const std::string& path, std::vector<glm::vec3>& points, std::vector<glm::vec3>& colors, const glm::vec3& color) {
+	MappedFile file;
+	if (!file.open(path)) {
+		std::cout << "ERROR::HEADLESS::VECTORS_NOT_READ " << path << "\n";
+		return false;
+	}
+	const char* p = (const char*)file.data();
+	const char* end = p + file.size();
+	while (p < end) {
+		glm::vec3 point;
+		glm::vec3 pointColor = color;
+		bool hasColor = false;
+		if (parseVectorLine(p, end, point, pointColor, hasColor)) {
+			points.push_back(point);
+			colors.push_back(hasColor ? pointColor : color);
+		}
+	}
+	return true;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Writes RGBA8 pixels as they come out of glReadPixels (bottom row first) to PPM or PNG.
+// The PNG is uncompressed (stored deflate blocks) so we don't need zlib, any viewer opens it.
+namespace imageWriter {
+
+	inline bool writePPM(const std::string& path, int width, int height, const uint8_t* rgba) {
+		FILE* file = std::fopen(path.c_str(), "wb");
+		if (file == NULL) {
+			return false;
+		}
+		std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+
+		std::vector<uint8_t> row(width * 3);
+		for (int y = height - 1; y >= 0; --y) {
+			const uint8_t* src = rgba + (size_t)y * width * 4;
+			for (int x = 0; x < width; ++x) {
+				row[x * 3 + 0] = src[x * 4 + 0];
+				row[x * 3 + 1] = src[x * 4 + 1];
+				row[x * 3 + 2] = src[x * 4 + 2];
+			}
+			std::fwrite(row.data(), 1, row.size(), file);
+		}
+		return std::fclose(file) == 0;
+	}
+
+
+	inline uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+		static uint32_t table[256];
+		static bool tableReady = false;
+		if (!tableReady) {
+			for (uint32_t n = 0; n < 256; ++n) {
+				uint32_t c = n;
+				for (int k = 0; k < 8; ++k) {
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				}
+				table[n] = c;
+			}
+			tableReady = true;
+		}
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i) {
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	inline void putBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+		out.push_back((uint8_t)(value >> 24));
+		out.push_back((uint8_t)(value >> 16));
+		out.push_back((uint8_t)(value >> 8));
+		out.push_back((uint8_t)value);
+	}
+
+	inline void writeChunk(FILE* file, const char* type, const std::vector<uint8_t>& data) {
+		std::vector<uint8_t> chunk;
+		putBigEndian(chunk, (uint32_t)data.size());
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		putBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+		std::fwrite(chunk.data(), 1, chunk.size(), file);
+	}
+
+
+	inline bool writePNG(const std::string& path, int width, int height, const uint8_t* rgba) {
+		FILE* file = std::fopen(path.c_str(), "wb");
+		if (file == NULL) {
+			return false;
+		}
+		const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		std::fwrite(signature, 1, sizeof(signature), file);
+
+		std::vector<uint8_t> header;
+		putBigEndian(header, (uint32_t)width);
+		putBigEndian(header, (uint32_t)height);
+		header.push_back(8); //bits per channel
+		header.push_back(2); //RGB, the framebuffer's alpha is whatever blending left in it (grid lines < 1)
+		header.push_back(0); //deflate
+		header.push_back(0); //adaptive filtering
+		header.push_back(0); //no interlace
+		writeChunk(file, "IHDR", header);
+
+		//raw scanlines, top row first, each starting with filter type 0, alpha dropped like in the PPM
+		size_t stride = (size_t)width * 4;
+		std::vector<uint8_t> raw;
+		raw.reserve(((size_t)width * 3 + 1) * height);
+		for (int y = height - 1; y >= 0; --y) {
+			raw.push_back(0);
+			const uint8_t* src = rgba + (size_t)y * stride;
+			for (int x = 0; x < width; ++x) {
+				raw.insert(raw.end(), src + x * 4, src + x * 4 + 3);
+			}
+		}
+
+		//zlib stream made of stored blocks
+		std::vector<uint8_t> zlib;
+		zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+		zlib.push_back(0x78);
+		zlib.push_back(0x01);
+		size_t offset = 0;
+		do {
+			size_t blockSize = std::min<size_t>(65535, raw.size() - offset);
+			bool last = offset + blockSize == raw.size();
+			zlib.push_back(last ? 1 : 0);
+			zlib.push_back((uint8_t)blockSize);
+			zlib.push_back((uint8_t)(blockSize >> 8));
+			zlib.push_back((uint8_t)~blockSize);
+			zlib.push_back((uint8_t)(~blockSize >> 8));
+			zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+			offset += blockSize;
+		} while (offset < raw.size());
+
+		uint32_t a = 1, b = 0;
+		for (uint8_t byte : raw) {
+			a = (a + byte) % 65521;
+			b = (b + a) % 65521;
+		}
+		putBigEndian(zlib, (b << 16) | a);
+		writeChunk(file, "IDAT", zlib);
+
+		writeChunk(file, "IEND", std::vector<uint8_t>());
+		return std::fclose(file) == 0;
+	}
+}
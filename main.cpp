@@ -11,16 +11,34 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <vector>
+#include <deque>
+#include <algorithm>
 
 
 #include "shader.h"
 #include "gridRenderer.h"
 #include "calculator.h"
-
-struct richVector {
-	glm::vec3 vector;
-	glm::vec3 color;
-};
+#include "vectorStore.h"
+#include "taskPool.h"
+#include "dynamicBuffer.h"
+#include "vertex.h"
+#include "arrowRenderer.h"
+#include "arrowChunks.h"
+#include "cameraUniforms.h"
+#include "shaderManager.h"
+#include "appOptions.h"
+#include "framebuffer.h"
+#include "frameExporter.h"
+#include "profiler.h"
+#include "gpuTransform.h"
+#include "vectorFile.h"
+#include "vectorImporter.h"
+#include "vectorStream.h"
+#include "sceneUpdater.h"
+#include "pickBuffer.h"
+#include "vectorBvh.h"
+#include "bvhBenchmark.h"
+#include "framePacer.h"
 
 struct calcData {
 	std::vector<size_t> indeces;
@@ -31,8 +49,18 @@ struct calcData {
 //open gl calls this function when we resize window
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
-richVector getUserVector(std::vector<glm::vec3>& vecs, std::vector<glm::vec3>& vecColors, std::vector<glm::vec3>& arrows, std::vector<glm::vec3>& arrColors);
+size_t applyDelta(const VectorDelta& delta, size_t from, size_t budget, VectorMirror& vectors, ArrowChunks& arrows);
+ArrowInstance vectorArrow(const VectorMirror& vectors, size_t i);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void char_callback(GLFWwindow* window, unsigned int codepoint);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void window_refresh_callback(GLFWwindow* window);
+void cameraMatrices(glm::mat4& model, glm::mat4& view);
+void drawScene(GridRenderer& grid, const std::vector<ArrowRenderer*>& arrowLayers, Shader& lineShader, Shader& arrowShader, Shader& gridShader, CameraUniforms& camera,
+	const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection, Profiler& profiler);
+int renderHeadless(const HeadlessOptions& options, GridRenderer& grid, ArrowRenderer& arrows, Shader& lineShader, Shader& arrowShader, Shader& gridShader, CameraUniforms& camera);
 
 	
 
@@ -40,14 +68,21 @@ const int screenWidth = 800;
 const int screenHeight = 600;
 const int slices = 10;
 
-const int lineWidth = 5;
-
 glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 0.3f);
 glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f); //to be added with cameraPos so that the camera looks at a new point when moved
 glm::vec3 worldUp = glm::vec3(0.0f, 0.1f, 0.0f);
 
 const glm::vec3 defaultVec = glm::vec3(0.1f, 0.1f, 0.0f);
 const glm::vec3 defaultCol = glm::vec3(1.0f, 0.0f, 0.0f);
+const glm::vec3 resultCol = glm::vec3(1.0f, 0.85f, 0.1f);
+const glm::vec3 batchCol = glm::vec3(0.2f, 0.8f, 1.0f);
+const glm::vec3 transformCol = glm::vec3(0.9f, 0.35f, 0.9f);
+const glm::vec3 selectedCol = glm::vec3(1.0f, 1.0f, 1.0f);
+
+const size_t deltaBudget = 1 << 18; //vector delta entries replayed per frame at most, a load shows up over a few frames
+
+//every program that draws the scene has one, hashed at compile time (see shader.h)
+static constexpr UniformId uModel("model");
 
 float dt = 0.0f;
 float lastFrame = 0.0f;
@@ -59,9 +94,17 @@ float lastX = 400, lastY = 300;
 bool firstMouse = true;
 bool vectorAdd = false;
 
+//a left click that didn't drag the camera asks for a pick at the cursor (window coordinates)
+bool pickRequested = false;
+double pickX = 0.0, pickY = 0.0;
+double pressX = 0.0, pressY = 0.0;
+
+//every callback counts here, an idle loop draws again when it changes (framePacer.h)
+unsigned int inputEvents = 0;
+bool cameraMoving = false; //a movement key is held, frames have to keep coming
+
 
 bool needUpdate = false;
-bool needGridUpdate = false;
 
 bool staticMode = true;
 
@@ -79,17 +122,33 @@ bool staticMode = true;
 
 
 	//##############================ MAIN ===================###################
-	int main() {
-		glfwInit();
-		//this just says that we need at least OPENGL VERSION 3 or glfw will fail
-		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	int main(int argc, char** argv) {
+		AppOptions options;
+		if (!parseOptions(argc, argv, options)) {
+			return -1;
+		}
+		const HeadlessOptions& headless = options.headless;
+		if (options.benchBvh) {
+			return benchmarkBvh();
+		}
+
+		GLFWwindow* window = NULL;
+		if (headless.enabled) {
+			//batch export: no visible window, we only need a context (see headless.h)
+			window = createHeadlessWindow();
+		}
+		else {
+			glfwInit();
+			//this just says that we need at least OPENGL VERSION 3 or glfw will fail
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 
-		//subset of opengl to emit features we don't need
-		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+			//subset of opengl to emit features we don't need
+			glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-		//we are going to create a windowwwwww
-		GLFWwindow* window = glfwCreateWindow(screenWidth, screenHeight, "RICHARD", NULL, NULL);
+			//we are going to create a windowwwwww
+			window = glfwCreateWindow(screenWidth, screenHeight, "RICHARD", NULL, NULL);
+		}
 		if (window == NULL) {
 			std::cout << "Failed to create GLFW window \n";
 			glfwTerminate();
@@ -114,6 +173,11 @@ bool staticMode = true;
 		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
 		glfwSetCursorPosCallback(window, mouse_callback);
+		glfwSetMouseButtonCallback(window, mouse_button_callback);
+		glfwSetKeyCallback(window, key_callback);
+		glfwSetCharCallback(window, char_callback);
+		glfwSetScrollCallback(window, scroll_callback);
+		glfwSetWindowRefreshCallback(window, window_refresh_callback);
 
 		glEnable(GL_DEPTH_TEST);
 
@@ -124,48 +188,82 @@ bool staticMode = true;
 
 		// ##################################  USER DEFINED VECTORS ########################################
 		
-		//users
-		std::vector<glm::vec3> userPoints;
-		std::vector<glm::vec3> userColors;
-
-		//fullCoords
-		std::vector<glm::vec3> arrowVertices;
-		std::vector<glm::vec3> arrowColor;
+		//the users live in the scene on the update thread (see below), this is the render thread's copy of them:
+		//addressed by the same handles, kept up to date by the deltas in every snapshot
+		VectorMirror vectors;
 
+		//calculator results, a separate layer that follows the vectors they were computed from
+		ArrowRenderer resultArrows;
 
-		// #################################################################################################
-		unsigned int vecVBO, vecVAO, vecColorVBO;
-		glGenBuffers(1, &vecVBO);
-		glGenBuffers(1, &vecColorVBO);
+		//output of the last whole-store batch
+		ArrowRenderer batchArrows;
+		std::shared_ptr<const BatchResult> shownBatch;
 
-		glGenVertexArrays(1, &vecVAO);
-		glBindVertexArray(vecVAO);
+		//the picked vectors through the matrix chain
+		ArrowRenderer transformArrows;
+		std::shared_ptr<const VectorArrays> shownTransform;
 
+		//the vector clicked in the view, drawn again a bit fatter on top of its own arrow
+		ArrowRenderer selectionArrows;
+		selectionArrows.shaftRadius *= 1.8f;
+		selectionArrows.headRadius *= 1.4f;
+		selectionArrows.headLength *= 1.2f;
+		VectorHandle selectedVector;
+		bool scrollToSelection = false;
+		PickBuffer pick;
+		std::deque<uint64_t> pickLayouts; //arrowChunks.layout() of every pick still in flight, oldest first
 
-		// binding vector vertices to vecVA0
-		glBindBuffer(GL_ARRAY_BUFFER, vecVBO);
-		glBufferData(GL_ARRAY_BUFFER, arrowVertices.size() * sizeof(glm::vec3), arrowVertices.data(), GL_STATIC_DRAW);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(0);
-
-
-		// binding vector colors to vecVAO
-		glBindBuffer(GL_ARRAY_BUFFER, vecColorVBO);
-		glBufferData(GL_ARRAY_BUFFER, arrowColor.size() * sizeof(glm::vec3), arrowColor.data(), GL_STATIC_DRAW);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(1);
+		//one instance (origin, direction, color) per user vector, drawn as shaft + head arrows, in spatial chunks so
+		//the ones out of view are skipped. Only the entries touched by an edit get re-uploaded
+		ArrowChunks arrowChunks;
+		bool frustumCulling = true;
 
 
 		
 
-		Shader ourShader("shader.vs", "shader.fs");
+		//view + projection live in one uniform buffer shared by all the programs
+		CameraUniforms camera;
+
+		//every program goes through the manager, saving a .vs/.fs reloads it in the running app
+		ShaderManager shaders(headless.enabled ? NULL : window, [&camera](Shader& shader) { camera.attach(shader); });
+		Shader& ourShader = shaders.load("lines", "shader.vs", "shader.fs");
+		Shader& arrowShader = shaders.load("arrows", "arrow.vs", "shader.fs");
+		Shader& gridShader = shaders.load("grid", "grid.vs", "grid.fs");
+		Shader& pickShader = shaders.load("pick", "arrow.vs", "pick.fs");
+
+		if (headless.enabled) {
+			//no update thread for an export, the scene is filled right here and handed over once
+			Scene scene;
+			scene.defaultColor = defaultCol;
+			std::vector<glm::vec3> points;
+			std::vector<glm::vec3> colors;
+			if (isVectorFile(options.vectorsPath)) {
+				scene.load(options.vectorsPath);
+			}
+			else if (!options.vectorsPath.empty() && loadVectorText(options.vectorsPath, points, colors, defaultCol)) {
+				VectorArrays values;
+				for (const glm::vec3& point : points) {
+					values.push_back(point);
+				}
+				scene.append(values.x.data(), values.y.data(), values.z.data(), colors.data(), values.size());
+			}
+			std::shared_ptr<VectorDelta> delta = scene.takeDelta();
+			if (delta) {
+				applyDelta(*delta, 0, delta->entries(), vectors, arrowChunks);
+			}
+			arrowChunks.upload();
+			arrowChunks.showAll();
+			int status = renderHeadless(headless, grid, arrowChunks.layer(), ourShader, arrowShader, gridShader, camera);
+			shaders.shutdown();
+			glfwTerminate();
+			return status;
+		}
+		shaders.startWatching();
 
 		// ######################################################################################################
 
 
-		//++++++++++++++ MODEL MATRIX (local -> world space) +++++++++++++++++++++
-		glm::mat4 model = glm::mat4(1.0f);
-		glm::mat4 view = glm::mat4(1.0f);
+		//++++++++++++++ PROJECTION (model and view come from cameraMatrices() every frame) +++++++++++++++++++++
 		glm::mat4 projection = glm::mat4(1.0f);
 
 
@@ -178,6 +276,12 @@ bool staticMode = true;
 		ImGui_ImplGlfw_InitForOpenGL(window, true);
 		ImGui_ImplOpenGL3_Init("#version 330");
 
+		//frames only when something changes (unless --no-idle), optionally capped
+		FramePacer pacer{ inputEvents };
+		pacer.idle = options.idle;
+		pacer.frameCap = options.frameCap;
+		pacer.setVsync(options.vsync);
+
 
 		//BUTTON STATES
 		bool newVecButPressed = false;
@@ -187,10 +291,50 @@ bool staticMode = true;
 
 		bool xzCheck = false;
 		bool yzCheck = false;
+		bool proceduralCheck = true;
+
+		//cpu + gpu time per pass, shown in the PROFILER window
+		Profiler profiler;
 
 		//=================== CALCULATOR STUFF ====================
-		Calculator calculator{ &userPoints };
+		//big batches (and BVH builds) are split over these threads, the render loop never waits for them
+		TaskPool pool;
+
+		//the vectors, the calculator, imports and the stream are updated on their own thread. The loop below sends it
+		//commands and shows its latest snapshot, a heavy update never costs a frame (sceneUpdater.h)
+		SceneUpdater updater{ &pool };
+		uint64_t appliedDelta = 0; //sequence of the last vector delta replayed into vectors / arrowChunks
+		size_t deltaProgress = 0; //entries replayed of the one after it (see VectorMirror::apply)
+		bool replayingDeltas = false; //some are left for the next frame
 		Calculation currCalculation;
+		int multiplyMode = 0; //scalar, dot, cross
+		float multiplyScalar = 2.0f;
+
+		//per-vector batches straight from the arrow buffer into the batch layer, when the driver can do it
+		GpuTransform gpuTransform;
+		bool gpuBatches = gpuTransform.available();
+		bool lastBatchOnGpu = false;
+		size_t gpuBatchCount = 0;
+		Operation gpuBatchOp = MULTIPLY;
+
+		//hovering and box selection go through the scene's BVH (snapshot.bvh), built on the update thread
+		float boxMin[3] = { -1.0f, -1.0f, -1.0f };
+		float boxMax[3] = { 1.0f, 1.0f, 1.0f };
+
+		//=================== LOADING / SAVING ====================
+		//.pvec files are mapped and go in at once, text is parsed in the background and streams in
+		updater.scene().defaultColor = defaultCol;
+		char vectorPath[256] = "vectors.pvec";
+		if (!options.vectorsPath.empty()) {
+			std::snprintf(vectorPath, sizeof(vectorPath), "%s", options.vectorsPath.c_str());
+			updater.scene().open(options.vectorsPath);
+		}
+
+		//live updates from another process, ids are the sender's and map to our handles
+		if (!options.streamSource.empty()) {
+			updater.scene().stream.start(options.streamSource);
+		}
+		updater.start();
 
 
 
@@ -198,47 +342,140 @@ bool staticMode = true;
 		while (!glfwWindowShouldClose(window))
 		{
 			float currFrame = glfwGetTime();
-			dt = currFrame - lastFrame;
+			dt = std::min(currFrame - lastFrame, 0.1f); //the first frame after an idle wait would jump the camera
 			lastFrame = currFrame;
+			profiler.beginFrame();
 			processInput(window); //check for input
+			if (cameraMoving) {
+				pacer.requestFrames(1);
+			}
+			{
+				ProfileScope scope(profiler, "shader reload");
+				shaders.beginFrame(); //swap in any shader that was edited and recompiled
+			}
+			//the newest snapshot from the update thread, if there is one since the last frame
+			bool fetched = updater.fetch();
+			if (fetched || replayingDeltas) {
+				ProfileScope scope(profiler, "vector deltas");
+				//deltas stay in the snapshots until confirmed, a skipped snapshot doesn't lose any. At most deltaBudget
+				//entries a frame: a big one (a load) goes on where it stopped in the next frame instead of stalling this one
+				const std::vector<std::shared_ptr<const VectorDelta>>& deltas = updater.snapshot().deltas;
+				size_t budget = deltaBudget;
+				bool applied = false;
+				for (const std::shared_ptr<const VectorDelta>& delta : deltas) {
+					if (delta->sequence <= appliedDelta) {
+						continue;
+					}
+					if (budget == 0) {
+						break;
+					}
+					size_t from = deltaProgress;
+					deltaProgress = applyDelta(*delta, from, budget, vectors, arrowChunks);
+					budget -= deltaProgress - from;
+					applied = true;
+					if (deltaProgress < delta->entries()) {
+						break;
+					}
+					appliedDelta = delta->sequence;
+					deltaProgress = 0;
+				}
+				replayingDeltas = !deltas.empty() && deltas.back()->sequence > appliedDelta;
+				updater.confirm(appliedDelta);
+				if (applied) {
+					//up right away, everything drawn or picked this frame has to match the new count
+					ProfileScope scope(profiler, "buffer updates", true);
+					arrowChunks.upload(!replayingDeltas);
+					needUpdate = true; //the selection follows
+				}
+			}
+			if (fetched) {
+				ProfileScope scope(profiler, "snapshot");
+				const SceneSnapshot& snapshot = updater.snapshot();
+
+				//only a handful of results, all of them again
+				resultArrows.instances().resize(snapshot.results.size());
+				for (size_t r = 0; r < snapshot.results.size(); ++r) {
+					resultArrows.instances().set(r, ArrowInstance{ glm::vec3(0.0f, 0.0f, 0.0f), snapshot.results[r], packColor(resultCol) });
+				}
+				resultArrows.upload();
+
+				if (snapshot.transformed != shownTransform) {
+					shownTransform = snapshot.transformed;
+					size_t count = shownTransform ? shownTransform->size() : 0;
+					transformArrows.instances().resize(count);
+					for (size_t i = 0; i < count; ++i) {
+						transformArrows.instances().set(i, ArrowInstance{ glm::vec3(0.0f, 0.0f, 0.0f), shownTransform->get(i), packColor(transformCol) });
+					}
+					transformArrows.upload();
+				}
+				if (snapshot.batch && snapshot.batch != shownBatch) {
+					//a background batch finished, show its vectors
+					shownBatch = snapshot.batch;
+					lastBatchOnGpu = false;
+					batchArrows.instances().resize(shownBatch->vectors.size());
+					for (size_t i = 0; i < shownBatch->vectors.size(); ++i) {
+						batchArrows.instances().set(i, ArrowInstance{ glm::vec3(0.0f, 0.0f, 0.0f), shownBatch->vectors.get(i), packColor(batchCol) });
+					}
+					batchArrows.upload();
+				}
+			}
+			const SceneSnapshot& snapshot = updater.snapshot();
 
 
 			//rendering commands go here
 			glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // opengl will wipe the art desk (window) with this color
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-			ourShader.use(); //ACTIVATE THE PROGRAM == rendering object (use the shaders)
-
-			
-			
 			// ================= Coordinates / Transformations =======================
 			//CAMERA / VIEW
-			glm::mat4 model = glm::mat4(1.0f);
-			glm::mat4 view = glm::mat4(1.0f);
-			if (staticMode) {
-				view = glm::translate(view, glm::vec3(0.0f, 0.0f, -1.0f));
-				model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-				model = glm::rotate(model, glm::radians(yaw), glm::vec3(0.0f, 1.0f, 0.0f));
-				model = glm::rotate(model, -glm::radians(pitch), glm::vec3(1.0f, 0.0f, 0.0f));
-		
-			}
-			else {
-				view = glm::lookAt(cameraPos, cameraPos + cameraFront, worldUp);
-			}
+			glm::mat4 model;
+			glm::mat4 view;
+			cameraMatrices(model, view);
 			
 			//projection = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, 0.1f, 100.0f); // Left, right, bottom, top, near, far
 			projection = glm::perspective(glm::radians(60.0f), (float)screenWidth / (float)screenHeight, 0.1f, 100.0f);
 
-			ourShader.setMat4("model", model);
-			ourShader.setMat4("view", view);
-			ourShader.setMat4("projection", projection);
-			glLineWidth(1.0f);
-			grid.draw(ourShader);
-
-
-			glLineWidth(lineWidth);
-			glBindVertexArray(vecVAO);
-			glDrawArrays(GL_LINES, 0, arrowVertices.size());
+			if (frustumCulling) {
+				ProfileScope scope(profiler, "cull");
+				arrowChunks.cull(projection * view * model);
+			}
+			else {
+				arrowChunks.showAll();
+			}
+			drawScene(grid, { &arrowChunks.layer(), &resultArrows, &batchArrows, &transformArrows, &selectionArrows }, ourShader, arrowShader, gridShader, camera, model, view, projection, profiler);
+
+			//PICKING: only the user vectors (the visible chunks), ids are their place in the chunk layer + 1
+			//with every slot in flight the click waits for a later frame (they keep coming while picks are pending)
+			if (pickRequested && !pick.full()) {
+				pickRequested = false;
+				ProfileScope scope(profiler, "pick", true);
+				int fbWidth, fbHeight, winWidth, winHeight;
+				glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
+				glfwGetWindowSize(window, &winWidth, &winHeight);
+				//window coordinates -> framebuffer pixels (they differ on high dpi screens), y goes up in gl
+				int x = (int)(pickX * fbWidth / std::max(winWidth, 1));
+				int y = fbHeight - 1 - (int)(pickY * fbHeight / std::max(winHeight, 1));
+				if (pick.begin(fbWidth, fbHeight, x, y)) {
+					pickShader.use();
+					pickShader.setMat4(uModel, model);
+					arrowChunks.layer().draw(pickShader);
+					pick.end();
+					pickLayouts.push_back(arrowChunks.layout());
+				}
+			}
+			uint32_t pickedId;
+			while (pick.poll(pickedId)) {
+				//places in the layer changed hands (removal, re-sort) while the answer was on its way, it may be another vector now
+				bool current = pickLayouts.front() == arrowChunks.layout();
+				pickLayouts.pop_front();
+				if (!current) {
+					continue;
+				}
+				size_t slot = pickedId - 1;
+				selectedVector = pickedId != PickBuffer::NONE && slot < arrowChunks.size() ? vectors.handle(arrowChunks.denseAt(slot)) : VectorHandle{};
+				scrollToSelection = vectors.valid(selectedVector);
+				needUpdate = true;
+			}
 			// ==========================================================================
 
 
@@ -246,57 +483,220 @@ bool staticMode = true;
 			
 			//============================= IMGUI ==================================
 			//let imgui know we are in a new frame
-			ImGui_ImplOpenGL3_NewFrame();
-			ImGui_ImplGlfw_NewFrame();
-			ImGui::NewFrame();
+			{
+				ProfileScope scope(profiler, "imgui NewFrame");
+				ImGui_ImplOpenGL3_NewFrame();
+				ImGui_ImplGlfw_NewFrame();
+				ImGui::NewFrame();
+			}
+			profiler.push("imgui windows");
+			pacer.textInput = io.WantTextInput;
+
+			//HOVER: the arrow under the cursor from the bvh, in model space where the vectors live. The update thread
+			//only hands one over while it matches the vectors, so nothing shows while imports or the stream keep changing them
+			const VectorBvh* bvh = snapshot.bvh.get();
+			if (!io.WantCaptureMouse && !vectors.empty() && glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) != GLFW_PRESS
+				&& bvh != nullptr && bvh->size() == vectors.size()) {
+				ProfileScope scope(profiler, "hover");
+				double cursorX, cursorY;
+				int winWidth, winHeight;
+				glfwGetCursorPos(window, &cursorX, &cursorY);
+				glfwGetWindowSize(window, &winWidth, &winHeight);
+				glm::vec2 ndc(2.0f * (float)cursorX / std::max(winWidth, 1) - 1.0f, 1.0f - 2.0f * (float)cursorY / std::max(winHeight, 1));
+				glm::mat4 toModel = glm::inverse(projection * view * model);
+				glm::vec4 rayStart = toModel * glm::vec4(ndc.x, ndc.y, -1.0f, 1.0f);
+				glm::vec4 rayEnd = toModel * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+				glm::vec3 from = glm::vec3(rayStart) / rayStart.w;
+				glm::vec3 direction = glm::normalize(glm::vec3(rayEnd) / rayEnd.w - from);
+				//about 4 pixels around the cursor, measured at the distance of the origin (fov is 60 degrees)
+				glm::vec3 eye = glm::vec3(glm::inverse(view * model)[3]);
+				float radius = 4.0f * 2.0f * glm::length(eye) * std::tan(glm::radians(30.0f)) / std::max(winHeight, 1);
+				size_t hovered = bvh->raycast(from, direction, radius);
+				if (hovered != VectorBvh::NOT_FOUND) {
+					glm::vec3 value = vectors.valueAt(hovered);
+					ImGui::SetTooltip("Vector %d (%.3f, %.3f, %.3f)", (int)hovered + 1, value.x * 10, value.y * 10, value.z * 10);
+				}
+			}
 
 			//============ MAIN WINDOWS ===============
 			ImGui::Begin("richard");
 			ImGui::Text("hello world");
+			ImGui::Checkbox("profiler", &profiler.showWindow);
 			
 			if (ImGui::Checkbox("XZ", &xzCheck)) {
-				needGridUpdate = true;
 				grid.enableXZ(xzCheck);
 			};
 
 			
 			if(ImGui::Checkbox("YZ", &yzCheck)) {
-				needGridUpdate = true;
 				grid.enableYZ(yzCheck);
 			};
+
+			if (ImGui::Checkbox("procedural grid", &proceduralCheck)) {
+				grid.setMode(proceduralCheck ? GridMode::PROCEDURAL : GridMode::LINES);
+			}
+			if (proceduralCheck) {
+				ImGui::Checkbox("adaptive grid", &grid.adaptive);
+				if (grid.adaptive) {
+					ImGui::Text("grid cell: %g", grid.levelSpacing());
+				}
+				else {
+					ImGui::SliderFloat("spacing", &grid.spacing, 0.01f, 0.5f);
+					ImGui::SliderFloat("extent", &grid.extent, 0.1f, 10.0f);
+				}
+			}
+			ImGui::Checkbox("frustum culling", &frustumCulling);
+			ImGui::SameLine();
+			ImGui::Text("%zu / %zu chunks, %zu arrows", arrowChunks.visibleChunks(), arrowChunks.chunkCount(), arrowChunks.visibleArrows());
+
+			//frame pacing
+			ImGui::Checkbox("idle when nothing changes", &pacer.idle);
+			ImGui::SameLine();
+			bool vsync = pacer.vsync();
+			if (ImGui::Checkbox("vsync", &vsync)) {
+				pacer.setVsync(vsync);
+			}
+			ImGui::SliderInt("fps cap", &pacer.frameCap, 0, 240, pacer.frameCap == 0 ? "off" : "%d");
+			ImGui::Text("%.0f fps, %.0f frames/s skipped, asleep %.0f%% of the time", pacer.fps(), pacer.skippedPerSecond(), pacer.asleep() * 100.0f);
+			ImGui::Text("update thread: tick %llu took %.2f ms", (unsigned long long)snapshot.tick, snapshot.tickMilliseconds);
 			//creating ui window
 
 			//creating a vector
 			if (ImGui::Button("NEW VEC")) {
-				needUpdate = true;
-				getUserVector(userPoints, userColors, arrowVertices, arrowColor);
-					
+				updater.post([](Scene& scene) { scene.add(defaultVec, defaultCol); });
 			}
 
-			if (userPoints.size() > 0) {
-				ImGui::Separator();
-				ImGui::BeginChild("VECTOR LIST");
-				
-				 for (size_t i = 0; i < userPoints.size(); ++i) {
-					 
-					//if the curr vector is changed
-					float currVec[3] = {userPoints[i].x * 10, userPoints[i].y * 10, userPoints[i].z * 10};
-					if (ImGui::InputFloat3(("Vector " + std::to_string(i + 1)).c_str(), currVec)) {
-						needUpdate = true;
-						userPoints[i] = glm::vec3(currVec[0] / 10.0f, currVec[1] / 10.0f, currVec[2] / 10.0f);
+			//creating a matrix, pick the size first
+			ImGui::SameLine();
+			if (ImGui::Button("NEW MAT")) {
+				newMatButPressed = !newMatButPressed;
+			}
+			if (newMatButPressed) {
+				ImGui::SameLine();
+				if (ImGui::SmallButton("3x3")) {
+					updater.post([](Scene& scene) { scene.calculator.addMatrix(3); });
+					newMatButPressed = false;
+				}
+				ImGui::SameLine();
+				if (ImGui::SmallButton("4x4")) {
+					updater.post([](Scene& scene) { scene.calculator.addMatrix(4); });
+					newMatButPressed = false;
+				}
+			}
+
+			//whole vector sets, .pvec (binary) or text / csv
+			ImGui::InputText("file", vectorPath, sizeof(vectorPath));
+			if (ImGui::Button("LOAD")) {
+				std::string path = vectorPath;
+				updater.post([path](Scene& scene) { scene.open(path); });
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("SAVE")) {
+				std::string path = vectorPath;
+				updater.post([path](Scene& scene) { scene.save(path); });
+			}
+			if (snapshot.streaming || snapshot.streamReceived > 0) {
+				ImGui::Text("stream: %llu updates, %zu / %zu queued", (unsigned long long)snapshot.streamReceived, snapshot.streamQueued, snapshot.streamCapacity);
+			}
+			if (snapshot.importing) {
+				ImGui::SameLine();
+				ImGui::ProgressBar(snapshot.importProgress, ImVec2(-1.0f, 0.0f), (std::to_string(snapshot.imported) + " vectors").c_str());
+			}
+
+			//rows are edited, glm stores columns; the translation is shown in vector units like the vectors
+			for (size_t m = 0; m < snapshot.matrices.size(); ++m) {
+				const Matrix& matrix = snapshot.matrices[m];
+				glm::mat4 value = matrix.value;
+				bool changed = false;
+				ImGui::PushID((int)m);
+				ImGui::Text("M%d (%dx%d)", (int)m + 1, matrix.size, matrix.size);
+				ImGui::SameLine();
+				if (ImGui::SmallButton("use")) {
+					updater.post([m](Scene& scene) { scene.calculator.appendMatrixToChain(m); });
+				}
+				for (int row = 0; row < 3; ++row) {
+					float cells[4] = { value[0][row], value[1][row], value[2][row], value[3][row] * 10 };
+					ImGui::PushID(row);
+					if (matrix.size == 4 ? ImGui::InputFloat4("##row", cells) : ImGui::InputFloat3("##row", cells)) {
+						changed = true;
+						for (int col = 0; col < matrix.size; ++col) {
+							value[col][row] = col == 3 ? cells[col] / 10.0f : cells[col];
+						}
 					}
+					ImGui::PopID();
+				}
+				if (matrix.size == 4) {
+					ImGui::TextDisabled("0 0 0 1");
+				}
+				ImGui::PopID();
+				if (changed) {
+					updater.post([m, value](Scene& scene) { scene.calculator.setMatrix(m, value); });
+				}
+			}
 
+			if (!vectors.empty()) {
+				ImGui::Separator();
+				ImGui::BeginChild("VECTOR LIST");
 
-					//if the curr vector color is changed
-					ImGui::SameLine();
-					ImVec4 color = ImVec4(userColors[i].x, userColors[i].y, userColors[i].z, 200.0f / 255.0f);
-					if (ImGui::ColorEdit4(("vec color" + std::to_string(i+1)).c_str(), (float*)&color, ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_NoLabel | ImGuiColorEditFlags_None)) {
-						needUpdate = true;
-						userColors[i] = glm::vec3(color.x, color.y, color.z);
+				//only the rows in view are submitted, ids come from the vector's slot (stable while others are removed)
+				//edits go to the update thread, the rows show them once its next snapshot is in
+				size_t selectedIndex = vectors.denseIndex(selectedVector);
+				ImGuiListClipper clipper;
+				clipper.Begin((int)vectors.size());
+				if (scrollToSelection && selectedIndex != VectorMirror::NOT_FOUND) {
+					//the picked row has to be submitted to be scrolled to, wherever it is
+					clipper.IncludeItemByIndex((int)selectedIndex);
+				}
+				while (clipper.Step()) {
+					for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+						size_t i = (size_t)row;
+						VectorHandle handle = vectors.handle(i);
+						glm::vec3 vec = vectors.valueAt(i);
+						glm::vec3 vecColor = vectors.colorAt(i);
+						ImGui::PushID((int)handle.index);
+
+						//if the curr vector is changed
+						float currVec[3] = {vec.x * 10, vec.y * 10, vec.z * 10};
+						if (ImGui::InputFloat3("##value", currVec)) {
+							glm::vec3 value(currVec[0] / 10.0f, currVec[1] / 10.0f, currVec[2] / 10.0f);
+							updater.post([handle, value](Scene& scene) { scene.set(handle, value); });
+						}
+
+						//pick it for the current calculation
+						ImGui::SameLine();
+						if (ImGui::SmallButton("use")) {
+							updater.post([handle](Scene& scene) { scene.calculator.appendToCurrent(handle); });
+						}
+
+						//if the curr vector color is changed
+						ImGui::SameLine();
+						ImVec4 color = ImVec4(vecColor.x, vecColor.y, vecColor.z, 200.0f / 255.0f);
+						if (ImGui::ColorEdit4("##color", (float*)&color, ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_NoLabel | ImGuiColorEditFlags_None)) {
+							glm::vec3 picked(color.x, color.y, color.z);
+							updater.post([handle, picked](Scene& scene) { scene.setColor(handle, picked); });
+						}
+
+						//the last vector takes its place (in the list and in the arrow buffer) with the next snapshot
+						ImGui::SameLine();
+						if (ImGui::SmallButton("x")) {
+							updater.post([handle](Scene& scene) { scene.remove(handle); });
+						}
+
+						ImGui::SameLine();
+						if (i == selectedIndex) {
+							ImGui::TextColored(ImVec4(selectedCol.x, selectedCol.y, selectedCol.z, 1.0f), "Vector %d (picked)", row + 1);
+							if (scrollToSelection) {
+								ImGui::SetScrollHereY(0.5f);
+								scrollToSelection = false;
+							}
+						}
+						else {
+							ImGui::Text("Vector %d", row + 1);
+						}
+						ImGui::PopID();
 					}
-				
-					ImGui::Separator();
 				}
+				clipper.End();
 				ImGui::EndChild();
 			}
 			ImGui::End();
@@ -306,76 +706,186 @@ bool staticMode = true;
 			ImGui::Begin("OPERATIONS");
 			ImGui::Text("BUTTONS: ");
 			if (ImGui::Button("+")) {
-				std::cout << "add clicked\n";
+				updater.post([](Scene& scene) { scene.calculator.setOperation(ADD); });
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("-")) {
+				updater.post([](Scene& scene) { scene.calculator.setOperation(SUBTRACT); });
 			}
 			ImGui::SameLine();
 			if (ImGui::Button("*")) {
-				std::cout << "multiply\n";
+				const Operation multiplyOps[] = { MULTIPLY, DOT, CROSS };
+				Operation op = multiplyOps[multiplyMode];
+				float scalar = multiplyScalar;
+				updater.post([op, scalar](Scene& scene) {
+					scene.calculator.setOperation(op);
+					scene.calculator.setScalar(scalar);
+				});
 			}
 			ImGui::SameLine();
 			if (ImGui::Button("=")) {
-				std::cout << "equal\n";
-
+				//results are computed (and kept up to date) on the update thread, they come back in the snapshots
+				updater.post([](Scene& scene) { scene.calculator.calculateCurrent(); });
 			}
 			ImGui::SameLine();
 			if (ImGui::Button("c")) {
-				userPoints.clear();
-				userColors.clear();
+				//the vectors, results and transformed set empty with the next snapshot, the batch layer is only ours
+				updater.post([](Scene& scene) { scene.clear(); });
+				batchArrows.instances().clear();
+				batchArrows.upload();
+				lastBatchOnGpu = false;
+				selectedVector = VectorHandle{};
+				needUpdate = true;
+			}
+
+			ImGui::SameLine();
+			if (ImGui::Button("M")) {
+				updater.post([](Scene& scene) { scene.calculator.setOperation(TRANSFORM); });
+			}
+
+			ImGui::Combo("multiply", &multiplyMode, "scalar\0dot\0cross\0");
+			if (multiplyMode == 0) {
+				ImGui::InputFloat("scalar", &multiplyScalar);
+			}
+			ImGui::Text("pick vectors with \"use\" in the list");
+			//or every vector whose tip is inside a box, in list order
+			ImGui::InputFloat3("box min", boxMin);
+			ImGui::InputFloat3("box max", boxMax);
+			if (ImGui::Button("use all inside")) {
+				//on the update thread, against its own BVH (built first if the vectors changed)
+				glm::vec3 low = glm::vec3(boxMin[0], boxMin[1], boxMin[2]) / 10.0f;
+				glm::vec3 high = glm::vec3(boxMax[0], boxMax[1], boxMax[2]) / 10.0f;
+				updater.post([low, high](Scene& scene) { scene.useAllInside(low, high); });
+			}
+			ImGui::SameLine();
+			ImGui::Text("%zu inside", snapshot.boxHits);
+			ImGui::Text("current: %s", snapshot.current.c_str());
+			ImGui::Text("matrix chain: %s", snapshot.chain.c_str());
+			ImGui::SameLine();
+			if (ImGui::SmallButton("clear chain")) {
+				updater.post([](Scene& scene) { scene.calculator.clearChain(); });
+			}
+			ImGui::Text("kernels: %s", Calculator::kernelName());
+			bool deterministic = snapshot.deterministic;
+			if (ImGui::Checkbox("deterministic sums", &deterministic)) {
+				kernels::ReductionMode mode = deterministic ? kernels::ReductionMode::DETERMINISTIC : kernels::ReductionMode::FAST;
+				updater.post([mode](Scene& scene) { scene.calculator.setReductionMode(mode); });
+			}
+
+			//live results, they follow edits to the vectors they came from
+			ImGui::Separator();
+			for (size_t r = 0; r < snapshot.results.size(); ++r) {
+				glm::vec3 result = snapshot.results[r];
+				ImGui::Text("r%d = (%.3f, %.3f, %.3f)", (int)r + 1, result.x * 10, result.y * 10, result.z * 10);
+				ImGui::SameLine();
+				if (ImGui::SmallButton(("use##r" + std::to_string(r)).c_str())) {
+					updater.post([r](Scene& scene) { scene.calculator.appendResultToCurrent(r); });
+				}
+			}
+			for (size_t d = 0; d < snapshot.scalarResults.size(); ++d) {
+				ImGui::Text("d%d = %.4f", (int)d + 1, snapshot.scalarResults[d] * 100);
+			}
+			if (!snapshot.last.empty()) {
+				ImGui::TextDisabled("last: %s", snapshot.last.c_str());
+			}
+
+			//the chosen operation over every vector at once, on the task pool
+			ImGui::Separator();
+			if (snapshot.batchRunning) {
+				ImGui::Text("batch running...");
+			}
+			else if (ImGui::Button("apply to all")) {
+				Operation op = snapshot.operation;
+				if (gpuBatches && GpuTransform::supports(op) && !vectors.empty()) {
+					//the chunk layer already holds every vector, the result never leaves the gpu (in chunk order, it is
+					//only drawn)
+					ProfileScope scope(profiler, "gpu batch", true);
+					batchArrows.instances().resizeDeviceOnly(arrowChunks.size());
+					gpuTransform.apply(arrowChunks.layer().instances().ID, batchArrows.instances().ID, arrowChunks.size(), op,
+						multiplyScalar, snapshot.chainMatrix, vectors.valueAt(0), packColor(batchCol));
+					lastBatchOnGpu = true;
+					gpuBatchCount = vectors.size();
+					gpuBatchOp = op;
+				}
+				else {
+					//works on the scene's vectors as they are when the command runs
+					float scalar = multiplyScalar;
+					updater.post([op, scalar](Scene& scene) { scene.calculator.runBatch(op, scalar); });
+				}
+			}
+			if (gpuTransform.available()) {
+				ImGui::SameLine();
+				ImGui::Checkbox("on the gpu (* x M)", &gpuBatches);
+			}
+			if (lastBatchOnGpu) {
+				ImGui::Text("batch %s over %zu vectors on the gpu (timing in the profiler)", operationSymbol(gpuBatchOp), gpuBatchCount);
+			}
+			else if (shownBatch && shownBatch->version > 0) {
+				const BatchResult& batch = *shownBatch;
+				ImGui::Text("batch %s over %zu vectors: %.2f ms (%zu threads)", operationSymbol(batch.op), batch.inputCount, batch.milliseconds, pool.workerCount());
+				if (batch.vectors.size() == 1) {
+					glm::vec3 v = batch.vectors.get(0);
+					ImGui::Text("= (%.3f, %.3f, %.3f)", v.x * 10, v.y * 10, v.z * 10);
+				}
 			}
 			ImGui::End();
 			//==================================
+
+			profiler.drawWindow();
+			profiler.pop(); //imgui windows
 			
 
-			ImGui::Render();
-			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+			{
+				ProfileScope scope(profiler, "imgui Render");
+				ImGui::Render();
+			}
+			{
+				ProfileScope scope(profiler, "imgui RenderDrawData", true);
+				ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+			}
 			//===============================================================================================================
 
 
 
 			// ===== Update Drawings =============
 			if (needUpdate) {
-				//render the changed 
-				arrowVertices.clear();
-				arrowColor.clear();
-				for (size_t i = 0; i < userPoints.size(); ++i) {
-					arrowVertices.push_back(glm::vec3(0.0f, 0.0f, 0.0f));
-					arrowVertices.push_back(userPoints[i]);
-
-					arrowColor.push_back(userColors[i]);
-					arrowColor.push_back(userColors[i]);
+				//follows edits, removal and clearing of the picked vector
+				selectionArrows.instances().clear();
+				size_t selectedIndex = vectors.denseIndex(selectedVector);
+				if (selectedIndex != VectorMirror::NOT_FOUND) {
+					ArrowInstance selected = vectorArrow(vectors, selectedIndex);
+					selected.color = packColor(selectedCol);
+					selectionArrows.instances().push_back(selected);
 				}
-				glBindBuffer(GL_ARRAY_BUFFER, vecVBO);
-				glBufferData(GL_ARRAY_BUFFER, arrowVertices.size() * sizeof(glm::vec3), arrowVertices.data(), GL_STATIC_DRAW);
-
-				// binding vector colors to vecVAO
-				glBindBuffer(GL_ARRAY_BUFFER, vecColorVBO);
-				glBufferData(GL_ARRAY_BUFFER, arrowColor.size() * sizeof(glm::vec3), arrowColor.data(), GL_STATIC_DRAW);
+				selectionArrows.upload();
 
 				needUpdate = false;
 			}
 
-			if (needGridUpdate) {
-				grid.draw(ourShader);
-				needGridUpdate = false;
-			}
-
 			//====================================
 			
+			profiler.endFrame(); //swap would mostly measure vsync
 			
 			glfwSwapBuffers(window); //two buffers, front and back. Back draws and get shown if and only if drawing is ready
-			glfwPollEvents(); /// check for keyboard input or mouse movement
+
+			//check for keyboard input or mouse movement, and sleep while nothing changes
+			//a published snapshot also wakes it up (the update thread posts an empty event)
+			pacer.wait(window, [&] {
+				const SceneSnapshot& latest = updater.snapshot();
+				return updater.fresh() || latest.streamQueued > 0 || latest.importing || latest.batchRunning || pick.pending() || replayingDeltas || shaders.reloadPending();
+			});
 	
 		}
 		//============= RENDER LOOP END ==========================
+		updater.stop(); //it posts glfw events, has to be gone before glfwTerminate
 
 
 		ImGui_ImplOpenGL3_Shutdown();
 		ImGui_ImplGlfw_Shutdown();
 		ImGui::DestroyContext();
 
+		shaders.shutdown();
 
-		glDeleteVertexArrays(1, &vecVAO);
-		glDeleteBuffers(1, &vecVBO);
 
 
 		glfwTerminate();
@@ -415,11 +925,125 @@ bool staticMode = true;
 
 
 
+
+
+	//model + view for the current camera mode (orbit around the origin or free WASD camera)
+	void cameraMatrices(glm::mat4& model, glm::mat4& view) {
+		model = glm::mat4(1.0f);
+		view = glm::mat4(1.0f);
+		if (staticMode) {
+			view = glm::translate(view, glm::vec3(0.0f, 0.0f, -1.0f));
+			model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			model = glm::rotate(model, glm::radians(yaw), glm::vec3(0.0f, 1.0f, 0.0f));
+			model = glm::rotate(model, -glm::radians(pitch), glm::vec3(1.0f, 0.0f, 0.0f));
+	
+		}
+		else {
+			view = glm::lookAt(cameraPos, cameraPos + cameraFront, worldUp);
+		}
+	}
+
+
+	//grid + every arrow layer, into whatever framebuffer is bound
+	void drawScene(GridRenderer& grid, const std::vector<ArrowRenderer*>& arrowLayers, Shader& lineShader, Shader& arrowShader, Shader& gridShader, CameraUniforms& camera,
+		const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection, Profiler& profiler) {
+
+		camera.update(view, projection, glm::vec3(glm::inverse(view)[3]));
+
+		{
+			ProfileScope scope(profiler, "grid draw", true);
+			lineShader.use(); //ACTIVATE THE PROGRAM == rendering object (use the shaders)
+			lineShader.setMat4(uModel, model);
+
+			gridShader.use();
+			gridShader.setMat4(uModel, model);
+
+			grid.setCamera(model, view);
+			grid.draw(lineShader, gridShader);
+		}
+
+		{
+			ProfileScope scope(profiler, "vector draw", true);
+			arrowShader.use();
+			arrowShader.setMat4(uModel, model);
+			for (ArrowRenderer* arrows : arrowLayers) {
+				arrows->draw(arrowShader);
+			}
+		}
+	}
+
+
+	//renders options.frames images into an offscreen target, orbiting once around the origin, and saves them
+	int renderHeadless(const HeadlessOptions& options, GridRenderer& grid, ArrowRenderer& arrows, Shader& lineShader, Shader& arrowShader, Shader& gridShader, CameraUniforms& camera) {
+		Framebuffer target(options.width, options.height);
+		FrameExporter exporter(options.width, options.height, options.outPattern);
+
+		arrows.upload();
+		glm::mat4 projection = glm::perspective(glm::radians(60.0f), (float)options.width / (float)options.height, 0.1f, 100.0f);
+		Profiler profiler; //never started, the scopes in drawScene do nothing
+
+		double start = glfwGetTime();
+		for (int frame = 0; frame < options.frames; ++frame) {
+			yaw = -90.0f + 360.0f * frame / options.frames;
+
+			glm::mat4 model;
+			glm::mat4 view;
+			cameraMatrices(model, view);
+
+			target.bind();
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			drawScene(grid, { &arrows }, lineShader, arrowShader, gridShader, camera, model, view, projection, profiler);
+
+			exporter.capture(frame);
+		}
+		exporter.finish();
+		Framebuffer::unbind();
+
+		std::cout << "HEADLESS::DONE " << exporter.written() << " frames (" << options.width << "x" << options.height << ") in "
+			<< (glfwGetTime() - start) << " s" << std::endl;
+		return exporter.failed() == 0 ? 0 : -1;
+	}
+
+
+	//entries [from, from + budget) of one tick of changes from the update thread into the mirror and the arrows,
+	//returns how far it got (see VectorMirror::apply). The chunk layer collects them as dirty ranges, so only what
+	//changed goes up with the next upload()
+	size_t applyDelta(const VectorDelta& delta, size_t from, size_t budget, VectorMirror& vectors, ArrowChunks& arrows) {
+		static std::vector<ArrowInstance> block; //render thread only, kept to save the allocation
+		if (from == 0) {
+			arrows.reserve(delta.size);
+		}
+		//the arrows follow the mirror's size, which grows as the entries come in
+		size_t done = vectors.apply(delta, from, budget, [&](size_t first, size_t count) {
+			if (vectors.size() > arrows.size()) {
+				arrows.resize(vectors.size());
+			}
+			if (count == 1) {
+				arrows.set(first, vectorArrow(vectors, first));
+				return;
+			}
+			//a piece of an appended block, in one copy
+			block.resize(count);
+			for (size_t k = 0; k < count; ++k) {
+				block[k] = vectorArrow(vectors, first + k);
+			}
+			arrows.set(first, block.data(), count);
+		});
+		arrows.resize(vectors.size());
+		return done;
+	}
+
+	//the arrow for dense entry i of the vectors
+	ArrowInstance vectorArrow(const VectorMirror& vectors, size_t i) {
+		return ArrowInstance{ glm::vec3(0.0f, 0.0f, 0.0f), vectors.valueAt(i), packColor(vectors.colorAt(i)) };
+	}
 
 
 	//CALLBACKS
 	void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 	{
+		++inputEvents;
 		glViewport(0, 0, width, height);
 	}
 
@@ -449,6 +1073,9 @@ bool staticMode = true;
 			cameraPos += glm::normalize(glm::cross(cameraFront, worldUp)) * movementSpeed;
 		}
 
+		cameraMoving = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS
+			|| glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+
 		if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS) {
 			vectorAdd = true;
 		}
@@ -460,7 +1087,29 @@ bool staticMode = true;
 
 
 
+	//a press and release on the same spot is a click (a pick), anything that moved was a camera drag
+	//installed before imgui's callbacks, which chain to it, so clicks on imgui windows are filtered here
+	void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
+		++inputEvents;
+		if (button != GLFW_MOUSE_BUTTON_LEFT || (ImGui::GetCurrentContext() != NULL && ImGui::GetIO().WantCaptureMouse)) {
+			return;
+		}
+		double xpos, ypos;
+		glfwGetCursorPos(window, &xpos, &ypos);
+		if (action == GLFW_PRESS) {
+			pressX = xpos;
+			pressY = ypos;
+		}
+		else if (action == GLFW_RELEASE && std::abs(xpos - pressX) + std::abs(ypos - pressY) < 4.0) {
+			pickRequested = true;
+			pickX = xpos;
+			pickY = ypos;
+		}
+	}
+
+
 	void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
+		++inputEvents;
 		if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
 			if (firstMouse)
 			{
@@ -497,24 +1146,19 @@ bool staticMode = true;
 
 	}
 
-	richVector getUserVector(std::vector<glm::vec3>& vecs, std::vector<glm::vec3>& vecColors, std::vector<glm::vec3>& arrows, std::vector<glm::vec3>& arrColors) {
-
-		vecs.push_back(defaultVec);
-		vecColors.push_back(defaultCol);
+	//the rest only wakes the idle loop, imgui chains to these (and handles the events itself)
+	void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+		++inputEvents;
+	}
 
-		arrows.clear();
-		arrColors.clear();
-		for (size_t i = 0; i < vecs.size(); ++i) {
-			arrows.push_back(glm::vec3(0.0f, 0.0f, 0.0f));
-			arrows.push_back(vecs[i]);
+	void char_callback(GLFWwindow* window, unsigned int codepoint) {
+		++inputEvents;
+	}
 
-			arrColors.push_back(vecColors[i]);
-			arrColors.push_back(vecColors[i]);
-		}
-	
-		return richVector{
-			defaultVec,
-			defaultCol
-		};
+	void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
+		++inputEvents;
+	}
 
+	void window_refresh_callback(GLFWwindow* window) {
+		++inputEvents;
 	}
\ No newline at end of file
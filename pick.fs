@@ -0,0 +1,10 @@
+#version 330 core
+out uint pickId;
+
+flat in uint vecId;
+
+// the picking pass writes which arrow covers the pixel instead of its color (see pickBuffer.h)
+void main()
+{
+   pickId = vecId;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+
+#include "framebuffer.h"
+
+// Which arrow is under the cursor, answered by the GPU.
+// A pick draws the arrow layer once more into an integer target (GL_R32UI) where every fragment stores its
+// instance + 1, with the scissor cut down to the few pixels around the cursor (arrows are only a couple of
+// pixels wide, so a 1x1 pick would need a very steady hand), so the pass costs a handful of fragments instead
+// of a frame. Those pixels are copied into a small pixel buffer with a fence behind it and poll() only maps it
+// once the fence has passed: the answer arrives a frame or two later, the render loop never waits for the GPU
+// (same ring idea as FrameExporter). The hit closest to the cursor wins.
+//   if (pick.begin(w, h, x, y)) { pickShader.use(); ...; arrows.draw(pickShader); pick.end(); }
+//   uint32_t id; while (pick.poll(id)) { ... }
+class PickBuffer {
+public:
+	static constexpr uint32_t NONE = 0; //the click hit no arrow, otherwise id = instance + 1
+	static constexpr int RADIUS = 2; //pixels around the cursor that still count, a 5x5 region
+	static constexpr int SIDE = 2 * RADIUS + 1;
+
+	explicit PickBuffer(int ringSize = 3)
+		: m_slots(ringSize) {
+		for (Slot& slot : m_slots) {
+			glGenBuffers(1, &slot.PBO);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+			glBufferData(GL_PIXEL_PACK_BUFFER, SIDE * SIDE * sizeof(uint32_t), NULL, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	};
+
+	~PickBuffer() {
+		for (Slot& slot : m_slots) {
+			if (slot.pending) {
+				glDeleteSync(slot.fence);
+			}
+			glDeleteBuffers(1, &slot.PBO);
+		}
+	};
+
+	PickBuffer(const PickBuffer&) = delete;
+	PickBuffer& operator=(const PickBuffer&) = delete;
+
+
+	//binds the id target (width x height, the size of the default framebuffer) for a pick at pixel (x, y),
+	//origin bottom left. False if the pixel is outside or every slot is still in flight; otherwise draw the
+	//pickable arrows with the pick program and call end()
+	bool begin(int width, int height, int x, int y) {
+		if (x < 0 || y < 0 || x >= width || y >= height || m_slots[m_next].pending) {
+			return false;
+		}
+		if (!m_target || m_target->width() != width || m_target->height() != height) {
+			m_target = std::make_unique<Framebuffer>(width, height, GL_R32UI);
+		}
+		//the region, cut at the edges of the target
+		Slot& slot = m_slots[m_next];
+		slot.x = std::max(x - RADIUS, 0);
+		slot.y = std::max(y - RADIUS, 0);
+		slot.width = std::min(x + RADIUS + 1, width) - slot.x;
+		slot.height = std::min(y + RADIUS + 1, height) - slot.y;
+		slot.cursorX = x - slot.x;
+		slot.cursorY = y - slot.y;
+
+		m_target->bind();
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(slot.x, slot.y, slot.width, slot.height);
+		const GLuint none[4] = { NONE, 0, 0, 0 };
+		glClearBufferuiv(GL_COLOR, 0, none);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		return true;
+	};
+
+	//queues the copy of the picked region and goes back to the default framebuffer
+	void end() {
+		Slot& slot = m_slots[m_next];
+		m_next = (m_next + 1) % m_slots.size();
+
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glReadPixels(slot.x, slot.y, slot.width, slot.height, GL_RED_INTEGER, GL_UNSIGNED_INT, (void*)0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot.pending = true;
+
+		glDisable(GL_SCISSOR_TEST);
+		Framebuffer::unbind();
+	};
+
+
+	//every slot is still in flight, begin() would refuse until poll() took an answer
+	bool full() const { return m_slots[m_next].pending; }
+
+	//a pick is still on its way, poll() will have an answer in a frame or two
+	bool pending() const {
+		for (const Slot& slot : m_slots) {
+			if (slot.pending) {
+				return true;
+			}
+		}
+		return false;
+	};
+
+	//oldest pick whose copy is done, never blocks. False while nothing has finished
+	bool poll(uint32_t& id) {
+		for (size_t i = 0; i < m_slots.size(); ++i) {
+			Slot& slot = m_slots[(m_next + i) % m_slots.size()];
+			if (!slot.pending) {
+				continue;
+			}
+			//picks finish in order, if this one isn't done the newer ones aren't either
+			GLenum state = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED) {
+				return false;
+			}
+			glDeleteSync(slot.fence);
+			slot.fence = 0;
+			slot.pending = false;
+
+			id = NONE;
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+			const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.width * slot.height * sizeof(uint32_t), GL_MAP_READ_BIT);
+			if (mapped != NULL) {
+				id = closest(slot, (const uint32_t*)mapped);
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			}
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			return true;
+		}
+		return false;
+	};
+
+
+
+private:
+	struct Slot {
+		unsigned int PBO = 0;
+		GLsync fence = 0;
+		bool pending = false;
+
+		//the region that was read, in target pixels, and where the cursor is inside it
+		int x = 0, y = 0, width = 0, height = 0;
+		int cursorX = 0, cursorY = 0;
+	};
+
+	std::unique_ptr<Framebuffer> m_target; //made on the first pick, remade when the window size changes
+	std::vector<Slot> m_slots;
+	size_t m_next = 0;
+
+
+	//the id nearest the cursor, rows come bottom up like the framebuffer
+	static uint32_t closest(const Slot& slot, const uint32_t* ids) {
+		uint32_t best = NONE;
+		int bestDistance = 0;
+		for (int row = 0; row < slot.height; ++row) {
+			for (int col = 0; col < slot.width; ++col) {
+				uint32_t id = ids[row * slot.width + col];
+				int distance = (col - slot.cursorX) * (col - slot.cursorX) + (row - slot.cursorY) * (row - slot.cursorY);
+				if (id != NONE && (best == NONE || distance < bestDistance)) {
+					best = id;
+					bestDistance = distance;
+				}
+			}
+		}
+		return best;
+	};
+};
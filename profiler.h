@@ -0,0 +1,339 @@
+#pragma once
+
+#include <glad/glad.h>
+#include "imgui.h"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+#include <iostream>
+
+// Frame profiler: named scopes timed on the CPU (steady clock) and, for the top level passes, on the GPU.
+// GPU times come from GL_TIME_ELAPSED queries kept in a ring of frames, a frame's results are only read once the
+// ring comes back to it (a few frames later), so reading them never waits on the GPU.
+// GL_TIME_ELAPSED queries can't nest, so only scopes opened while no other GPU scope is running get a query.
+//
+//   profiler.beginFrame();
+//   { ProfileScope scope(profiler, "grid", true); grid.draw(...); }
+//   profiler.endFrame();
+class Profiler {
+public:
+	struct Event {
+		const char* name;      //string literals only, we keep the pointer
+		int depth;
+		double start;          //ms since the profiler started
+		double cpu;            //ms
+		double gpu = -1.0;     //ms, -1 if the scope had no query (or the result never arrived)
+		int query = -1;        //index into the frame's query pool
+	};
+
+	struct Frame {
+		long long number = 0;
+		double start = 0.0;
+		double cpu = 0.0;
+		double gpu = 0.0;
+		std::vector<Event> events;
+	};
+
+	bool enabled = true;
+	bool showWindow = true;
+
+	Profiler(int historySize = 240, int latency = 4)
+		: m_history(historySize), m_slots(latency) {
+		m_origin = Clock::now();
+	};
+
+	~Profiler() {
+		for (Slot& slot : m_slots) {
+			if (!slot.queries.empty()) {
+				glDeleteQueries((GLsizei)slot.queries.size(), slot.queries.data());
+			}
+		}
+	};
+
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+
+
+	void beginFrame() {
+		if (!enabled) {
+			return;
+		}
+		Slot& slot = m_slots[m_frameNumber % m_slots.size()];
+		//this slot still holds the frame from `latency` frames ago, its queries are done by now
+		if (slot.waiting) {
+			collect(slot);
+		}
+		slot.frame.number = m_frameNumber;
+		slot.frame.start = now();
+		slot.frame.events.clear();
+		slot.used = 0;
+		m_open.clear();
+		m_gpuOpen = false;
+		m_inFrame = true;
+	};
+
+	void endFrame() {
+		if (!m_inFrame) {
+			return;
+		}
+		while (!m_open.empty()) {
+			pop(); //unbalanced scopes get closed here
+		}
+		Slot& slot = m_slots[m_frameNumber % m_slots.size()];
+		slot.frame.cpu = now() - slot.frame.start;
+		slot.waiting = true;
+		m_inFrame = false;
+		++m_frameNumber;
+	};
+
+
+	//gpu: also time the scope with a GL_TIME_ELAPSED query (ignored when nested in another gpu scope)
+	void push(const char* name, bool gpu = false) {
+		if (!m_inFrame) {
+			return;
+		}
+		Slot& slot = m_slots[m_frameNumber % m_slots.size()];
+		Event event{ name, (int)m_open.size(), now(), 0.0 };
+		if (gpu && !m_gpuOpen) {
+			if (slot.used == slot.queries.size()) {
+				unsigned int query;
+				glGenQueries(1, &query);
+				slot.queries.push_back(query);
+			}
+			event.query = (int)slot.used++;
+			glBeginQuery(GL_TIME_ELAPSED, slot.queries[event.query]);
+			m_gpuOpen = true;
+		}
+		m_open.push_back(slot.frame.events.size());
+		slot.frame.events.push_back(event);
+	};
+
+	void pop() {
+		if (!m_inFrame || m_open.empty()) {
+			return;
+		}
+		Slot& slot = m_slots[m_frameNumber % m_slots.size()];
+		Event& event = slot.frame.events[m_open.back()];
+		m_open.pop_back();
+		event.cpu = now() - event.start;
+		if (event.query >= 0) {
+			glEndQuery(GL_TIME_ELAPSED);
+			m_gpuOpen = false;
+		}
+	};
+
+
+	//finished frames (cpu + gpu), oldest first
+	std::vector<const Frame*> history() const {
+		std::vector<const Frame*> frames;
+		size_t count = std::min(m_collected, m_history.size());
+		for (size_t i = 0; i < count; ++i) {
+			frames.push_back(&m_history[(m_collected - count + i) % m_history.size()]);
+		}
+		return frames;
+	};
+
+
+	//rolling frame time plot, per scope averages and a flame graph of the latest finished frame
+	void drawWindow() {
+		if (!showWindow) {
+			return;
+		}
+		ImGui::Begin("PROFILER", &showWindow);
+		ImGui::Checkbox("enabled", &enabled);
+		ImGui::SameLine();
+		if (ImGui::Button("dump trace")) {
+			writeChromeTrace("profile_trace.json");
+		}
+
+		std::vector<const Frame*> frames = history();
+		if (frames.empty()) {
+			ImGui::Text("no frames yet");
+			ImGui::End();
+			return;
+		}
+
+		std::vector<float> cpuTimes;
+		std::vector<float> gpuTimes;
+		for (const Frame* frame : frames) {
+			cpuTimes.push_back((float)frame->cpu);
+			gpuTimes.push_back((float)frame->gpu);
+		}
+		const Frame& last = *frames.back();
+		float width = ImGui::GetContentRegionAvail().x;
+		char overlay[64];
+		std::snprintf(overlay, sizeof(overlay), "cpu %.2f ms", last.cpu);
+		ImGui::PlotLines("##cpu", cpuTimes.data(), (int)cpuTimes.size(), 0, overlay, 0.0f, 33.3f, ImVec2(width, 60.0f));
+		std::snprintf(overlay, sizeof(overlay), "gpu %.2f ms", last.gpu);
+		ImGui::PlotLines("##gpu", gpuTimes.data(), (int)gpuTimes.size(), 0, overlay, 0.0f, 33.3f, ImVec2(width, 60.0f));
+
+		//flame graph, one row per depth, x is time within the frame
+		ImGui::Separator();
+		const float rowHeight = ImGui::GetTextLineHeight() + 4.0f;
+		int depths = 1;
+		for (const Event& event : last.events) {
+			depths = std::max(depths, event.depth + 1);
+		}
+		ImVec2 origin = ImGui::GetCursorScreenPos();
+		ImDrawList* drawList = ImGui::GetWindowDrawList();
+		double scale = last.cpu > 0.0 ? width / last.cpu : 0.0;
+		for (const Event& event : last.events) {
+			ImVec2 min(origin.x + (float)((event.start - last.start) * scale), origin.y + event.depth * rowHeight);
+			ImVec2 max(std::max(min.x + 1.0f, min.x + (float)(event.cpu * scale)), min.y + rowHeight - 1.0f);
+			ImU32 color = ImColor::HSV((float)((uintptr_t)event.name % 97) / 97.0f, 0.5f, 0.7f);
+			drawList->AddRectFilled(min, max, color);
+			drawList->PushClipRect(min, max, true);
+			drawList->AddText(ImVec2(min.x + 2.0f, min.y + 2.0f), IM_COL32_WHITE, event.name);
+			drawList->PopClipRect();
+			if (ImGui::IsMouseHoveringRect(min, max)) {
+				ImGui::SetTooltip("%s\ncpu %.3f ms\ngpu %s", event.name, event.cpu, event.gpu >= 0.0 ? std::to_string(event.gpu).c_str() : "-");
+			}
+		}
+		ImGui::Dummy(ImVec2(width, depths * rowHeight));
+
+		//averages over the whole history
+		ImGui::Separator();
+		if (ImGui::BeginTable("scopes", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+			ImGui::TableSetupColumn("scope");
+			ImGui::TableSetupColumn("cpu ms");
+			ImGui::TableSetupColumn("gpu ms");
+			ImGui::TableHeadersRow();
+			for (const Event& event : last.events) {
+				double cpu = 0.0, gpu = 0.0;
+				int samples = 0, gpuSamples = 0;
+				for (const Frame* frame : frames) {
+					for (const Event& other : frame->events) {
+						if (other.name == event.name && other.depth == event.depth) {
+							cpu += other.cpu;
+							++samples;
+							if (other.gpu >= 0.0) {
+								gpu += other.gpu;
+								++gpuSamples;
+							}
+						}
+					}
+				}
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::Text("%*s%s", event.depth * 2, "", event.name);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", cpu / std::max(samples, 1));
+				ImGui::TableNextColumn();
+				if (gpuSamples > 0) {
+					ImGui::Text("%.3f", gpu / gpuSamples);
+				}
+				else {
+					ImGui::TextUnformatted("-");
+				}
+			}
+			ImGui::EndTable();
+		}
+		ImGui::End();
+	};
+
+
+	//chrome://tracing / Perfetto JSON, cpu scopes on thread 1, gpu durations on thread 2 (placed at their cpu start,
+	//GL_TIME_ELAPSED only gives lengths)
+	bool writeChromeTrace(const std::string& path) const {
+		FILE* file = std::fopen(path.c_str(), "w");
+		if (file == NULL) {
+			std::cout << "ERROR::PROFILER::TRACE_NOT_WRITTEN " << path << std::endl;
+			return false;
+		}
+		std::fprintf(file, "{\"traceEvents\":[\n");
+		std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"cpu\"}},\n");
+		std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"gpu\"}}");
+		for (const Frame* frame : history()) {
+			std::fprintf(file, ",\n{\"name\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%lld}}",
+				frame->start * 1000.0, frame->cpu * 1000.0, frame->number);
+			for (const Event& event : frame->events) {
+				std::fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+					event.name, event.start * 1000.0, event.cpu * 1000.0);
+				if (event.gpu >= 0.0) {
+					std::fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.3f,\"dur\":%.3f}",
+						event.name, event.start * 1000.0, event.gpu * 1000.0);
+				}
+			}
+		}
+		std::fprintf(file, "\n]}\n");
+		bool ok = std::fclose(file) == 0;
+		std::cout << "PROFILER::TRACE " << path << std::endl;
+		return ok;
+	};
+
+
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Slot {
+		Frame frame;
+		std::vector<unsigned int> queries; //pool, grows to the most gpu scopes seen in one frame
+		size_t used = 0;
+		bool waiting = false; //recorded, results not collected yet
+	};
+
+	std::vector<Frame> m_history;
+	size_t m_collected = 0;
+
+	std::vector<Slot> m_slots;
+	long long m_frameNumber = 0;
+	std::vector<size_t> m_open; //indices of the scopes still open, innermost last
+	bool m_gpuOpen = false;
+	bool m_inFrame = false;
+
+	Clock::time_point m_origin;
+
+
+	double now() const {
+		return std::chrono::duration<double, std::milli>(Clock::now() - m_origin).count();
+	};
+
+	//reads the slot's queries (without waiting) and moves the frame into the history
+	void collect(Slot& slot) {
+		slot.waiting = false;
+		slot.frame.gpu = 0.0;
+		for (Event& event : slot.frame.events) {
+			if (event.query < 0) {
+				continue;
+			}
+			unsigned int query = slot.queries[event.query];
+			GLint available = 0;
+			glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) {
+				continue; //gpu is more than `latency` frames behind, drop the sample instead of stalling
+			}
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+			event.gpu = elapsed / 1.0e6;
+			slot.frame.gpu += event.gpu;
+		}
+		m_history[m_collected % m_history.size()] = slot.frame;
+		++m_collected;
+	};
+};
+
+
+//times everything until the end of the enclosing block
+class ProfileScope {
+public:
+	ProfileScope(Profiler& profiler, const char* name, bool gpu = false)
+		: m_profiler{ profiler } {
+		m_profiler.push(name, gpu);
+	};
+
+	~ProfileScope() {
+		m_profiler.pop();
+	};
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+
+
+private:
+	Profiler& m_profiler;
+};
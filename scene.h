@@ -0,0 +1,352 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "vectorStore.h"
+#include "vectorDelta.h"
+#include "calculator.h"
+#include "vectorBvh.h"
+#include "vectorFile.h"
+#include "vectorImporter.h"
+#include "vectorStream.h"
+#include "taskPool.h"
+#include "vertex.h"
+
+// Everything the app computes, owned by the update thread (see sceneUpdater.h): the user vectors, the
+// calculator, the importer and stream that feed the vectors, and the BVH over them.
+// Every change to the vectors goes through here and is written down in a VectorDelta, which the render thread
+// replays onto its own copy (the arrows, the list). Nothing in here touches GL.
+//   scene.load("big.pvec"); std::shared_ptr<VectorDelta> delta = scene.takeDelta(); mirror.apply(*delta);
+class Scene {
+public:
+	static constexpr size_t STREAM_BUDGET = 1 << 18; //stream updates applied per tick at most
+	static constexpr uint32_t MAX_STREAM_ID = 1 << 24;
+	static constexpr double BVH_QUIET = 0.25; //seconds without imports / stream updates before the BVH is rebuilt
+
+	VectorStore vectors;
+	Calculator calculator;
+	VectorImporter importer;
+	VectorStream stream;
+	glm::vec3 defaultColor = glm::vec3(1.0f, 0.0f, 0.0f);
+
+	explicit Scene(TaskPool* pool = nullptr)
+		: calculator{ &vectors, pool }, m_pool{ pool } {
+	};
+
+
+	// ============ vectors ============
+
+	//nan / inf never get in (files, the stream and typed values can all have them), the BVH bins and the chunk
+	//sort can't place them. Single vectors are refused, blocks get them zeroed
+	VectorHandle add(const glm::vec3& value, const glm::vec3& color) {
+		if (!finite(value)) {
+			return VectorHandle{};
+		}
+		VectorHandle handle = vectors.add(value, color);
+		written(vectors.size() - 1);
+		changedSet(false);
+		return handle;
+	};
+
+	//one block into the store, in order
+	void append(const float* x, const float* y, const float* z, const glm::vec3* colors, size_t count) {
+		size_t first = vectors.append(x, y, z, colors, count);
+		zeroNonFinite(first);
+		written(first, count);
+		changedSet(true);
+	};
+
+	void set(VectorHandle handle, const glm::vec3& value) {
+		if (!vectors.valid(handle) || !finite(value)) {
+			return;
+		}
+		vectors.set(handle, value);
+		size_t dense = vectors.denseIndex(handle);
+		written(dense);
+		calculator.vectorChanged(handle);
+		refitBvh(dense, value);
+	};
+
+	void setColor(VectorHandle handle, const glm::vec3& color) {
+		if (vectors.valid(handle)) {
+			vectors.setColor(handle, color);
+			written(vectors.denseIndex(handle));
+		}
+	};
+
+	//the last vector moves into the hole
+	void remove(VectorHandle handle) {
+		size_t hole = vectors.remove(handle);
+		if (hole == VectorStore::NOT_FOUND) {
+			return;
+		}
+		written(hole); //past the end if it was the last one, then only the size changes
+		changedSet(false);
+	};
+
+	//the vectors, the calculator and whatever is still being imported
+	void clear() {
+		importer.cancel();
+		vectors.clear();
+		calculator.clear();
+		written(0); //nothing to write, the delta only has to know the size dropped
+		changedSet(false);
+	};
+
+
+	// ============ files ============
+
+	//a .pvec file, mapped: the arrays are copied as they are, nothing is parsed
+	bool load(const std::string& path) {
+		VectorFile file;
+		if (!file.open(path)) {
+			return false;
+		}
+		std::vector<glm::vec3> colors(file.size(), defaultColor);
+		if (file.colors() != nullptr) {
+			for (size_t i = 0; i < file.size(); ++i) {
+				colors[i] = unpackColor(file.colors()[i]);
+			}
+		}
+		append(file.x(), file.y(), file.z(), colors.data(), file.size());
+		std::cout << "loaded " << file.size() << " vectors from " << path << "\n";
+		return true;
+	};
+
+	//.pvec at once, text in the background (the chunks come in through update())
+	void open(const std::string& path) {
+		if (isVectorFile(path)) {
+			load(path);
+		}
+		else {
+			importer.start(path, defaultColor);
+		}
+	};
+
+	bool save(const std::string& path) const {
+		if (!isVectorFile(path)) {
+			std::cout << "ERROR::VECTOR_FILE::NOT_PVEC " << path << " (saving only writes .pvec)\n";
+			return false;
+		}
+		std::vector<uint32_t> colors(vectors.size());
+		for (size_t i = 0; i < vectors.size(); ++i) {
+			colors[i] = packColor(vectors.colorAt(i));
+		}
+		return saveVectorFile(path, vectors.values(), &colors);
+	};
+
+
+	// ============ tick ============
+
+	//imported chunks, a bounded batch of stream updates, finished batches, results and the transformed set
+	//downstream of any edit, and the BVH once things calmed down. True if anything the render thread shows changed
+	bool update() {
+		bool changed = false;
+
+		//a few imported chunks per tick, the rest waits in the importer
+		m_chunks.clear();
+		if (importer.poll(m_chunks) > 0) {
+			for (VectorImporter::Chunk& chunk : m_chunks) {
+				append(chunk.values.x.data(), chunk.values.y.data(), chunk.values.z.data(), chunk.colors.data(), chunk.values.size());
+			}
+			changed = true;
+		}
+		//bounded, whatever doesn't fit waits in the ring for the next tick
+		if (stream.drain(m_streamUpdates, STREAM_BUDGET) > 0) {
+			applyStream(m_streamUpdates);
+			changed = true;
+		}
+
+		if (calculator.beginFrame()) {
+			m_batch = std::make_shared<const BatchResult>(calculator.batchResult());
+			changed = true;
+		}
+		m_changedResults.clear();
+		if (calculator.update(m_changedResults)) {
+			changed = true;
+		}
+		if (calculator.updateTransform()) {
+			m_transformed = std::make_shared<const VectorArrays>(calculator.transformed());
+			changed = true;
+		}
+
+		if (m_bvhStale && seconds() - m_bulkChangedAt > BVH_QUIET) {
+			rebuildBvh();
+			changed = true;
+		}
+		return changed;
+	};
+
+	//an import, a stream or a batch is going (or the BVH is waiting to be rebuilt), the next tick should come soon
+	bool busy() const {
+		return importer.busy() || stream.running() || stream.queued() > 0 || calculator.batchRunning() || (m_bvhStale && !vectors.empty());
+	};
+
+
+	// ============ for the render thread ============
+
+	//everything that happened to the vectors since the last call, nullptr if nothing did
+	std::shared_ptr<VectorDelta> takeDelta() {
+		return std::move(m_delta);
+	};
+
+	//only while it matches the vectors, nullptr otherwise
+	std::shared_ptr<const VectorBvh> bvh() const { return m_bvhStale ? nullptr : m_bvh; }
+
+	std::shared_ptr<const BatchResult> batch() const { return m_batch; }
+	std::shared_ptr<const VectorArrays> transformed() const { return m_transformed; }
+
+
+	// ============ queries ============
+
+	//appends every vector whose tip is inside the box to the current calculation, in list order. Returns how many
+	size_t useAllInside(const glm::vec3& min, const glm::vec3& max) {
+		if (m_bvhStale || !m_bvh) {
+			rebuildBvh();
+		}
+		m_hits.clear();
+		m_bvh->queryBox(min, max, m_hits);
+		std::sort(m_hits.begin(), m_hits.end());
+		for (size_t i : m_hits) {
+			calculator.appendToCurrent(vectors.handle(i));
+		}
+		return m_hits.size();
+	};
+	size_t boxHits() const { return m_hits.size(); } //of the last useAllInside
+
+
+
+private:
+	TaskPool* m_pool;
+	std::shared_ptr<VectorDelta> m_delta;
+
+	std::vector<VectorImporter::Chunk> m_chunks;
+	std::vector<StreamUpdate> m_streamUpdates;
+	std::vector<VectorHandle> m_streamHandles; //sender's ids -> our handles
+	std::vector<size_t> m_changedResults;
+
+	std::shared_ptr<const BatchResult> m_batch;
+	std::shared_ptr<const VectorArrays> m_transformed;
+
+	//the render thread may be reading a published BVH, so one that was published is never changed, only replaced
+	//(by a rebuild, or by a refitted copy)
+	std::shared_ptr<VectorBvh> m_bvh;
+	bool m_bvhStale = true;
+	double m_bulkChangedAt = 0.0; //last import / stream batch, the BVH waits until they stop coming
+	std::vector<size_t> m_hits;
+
+
+	//dense entry i changed, into the open delta
+	void written(size_t i) {
+		if (!m_delta) {
+			m_delta = std::make_shared<VectorDelta>();
+		}
+		if (i < vectors.size()) {
+			m_delta->write(vectors, i);
+		}
+		m_delta->size = vectors.size();
+	};
+
+	//a whole appended block, kept as one (see VectorDelta)
+	void written(size_t first, size_t count) {
+		if (!m_delta) {
+			m_delta = std::make_shared<VectorDelta>();
+		}
+		if (count > 0) {
+			m_delta->writeBlock(vectors, first, count);
+		}
+		m_delta->size = vectors.size();
+	};
+
+	void changedSet(bool bulk) {
+		m_bvhStale = true;
+		if (bulk) {
+			m_bulkChangedAt = seconds();
+		}
+	};
+
+	//a single moved vector: refit in place, on a copy if a snapshot still holds this one. The count stays, so only
+	//a tree worn out by refits needs a rebuild
+	void refitBvh(size_t dense, const glm::vec3& tip) {
+		if (m_bvhStale || !m_bvh || m_bvh->size() != vectors.size()) {
+			changedSet(false);
+			return;
+		}
+		//only this thread publishes and drops snapshots, a count of 1 can't go up behind our back
+		if (m_bvh.use_count() > 1) {
+			m_bvh = std::make_shared<VectorBvh>(*m_bvh);
+		}
+		m_bvh->refit(dense, tip);
+		if (m_bvh->needsRebuild()) {
+			changedSet(false);
+		}
+	};
+
+	void rebuildBvh() {
+		auto bvh = std::make_shared<VectorBvh>();
+		bvh->build(vectors.values(), m_pool);
+		m_bvh = std::move(bvh);
+		m_bvhStale = false;
+	};
+
+	//stream updates into the store: new ids become vectors, known ones move
+	void applyStream(const std::vector<StreamUpdate>& updates) {
+		for (const StreamUpdate& update : updates) {
+			if (update.id >= MAX_STREAM_ID) {
+				continue;
+			}
+			if (update.id >= m_streamHandles.size()) {
+				m_streamHandles.resize(update.id + 1);
+			}
+			glm::vec3 value(update.x, update.y, update.z);
+			if (!finite(value)) {
+				continue;
+			}
+			VectorHandle& handle = m_streamHandles[update.id];
+			if (!vectors.valid(handle)) {
+				//new id (or its vector was removed / cleared): it comes back as a new vector
+				handle = vectors.add(value, update.color != 0 ? unpackColor(update.color) : defaultColor);
+				written(vectors.size() - 1);
+				continue;
+			}
+			vectors.set(handle, value);
+			if (update.color != 0) {
+				vectors.setColor(handle, unpackColor(update.color));
+			}
+			written(vectors.denseIndex(handle));
+			calculator.vectorChanged(handle);
+		}
+		changedSet(true);
+	};
+
+	//the block appended at first: nan / inf vectors become 0, in place
+	void zeroNonFinite(size_t first) {
+		const VectorArrays& values = vectors.values();
+		size_t zeroed = 0;
+		for (size_t i = first; i < vectors.size(); ++i) {
+			if (!finite(values.get(i))) {
+				vectors.set(vectors.handle(i), glm::vec3(0.0f));
+				++zeroed;
+			}
+		}
+		if (zeroed > 0) {
+			std::cout << "ERROR::SCENE::NON_FINITE " << zeroed << " vectors had a nan / inf component, they are 0 now\n";
+		}
+	};
+
+	static bool finite(const glm::vec3& value) {
+		return std::isfinite(value.x) && std::isfinite(value.y) && std::isfinite(value.z);
+	};
+
+	static double seconds() {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	};
+};
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+#include "scene.h"
+#include "tripleBuffer.h"
+
+// What the render thread gets to see of the scene after one update tick. Never changed once published.
+// The vectors come as deltas: every one the render thread hasn't confirmed yet is in every snapshot (oldest
+// first), so skipping snapshots never loses a change. The rest is the state as of that tick.
+struct SceneSnapshot {
+	uint64_t tick = 0;
+	std::vector<std::shared_ptr<const VectorDelta>> deltas;
+	std::shared_ptr<const VectorBvh> bvh; //over the vectors after the deltas, nullptr while it is out of date
+	std::shared_ptr<const BatchResult> batch; //a new pointer for every finished batch
+	std::shared_ptr<const VectorArrays> transformed; //the picked vectors through the chain, same
+
+	//calculator
+	std::vector<glm::vec3> results;
+	std::vector<float> scalarResults;
+	std::vector<Matrix> matrices;
+	std::string current;
+	std::string chain;
+	std::string last;
+	Operation operation = ADD;
+	glm::mat4 chainMatrix = glm::mat4(1.0f);
+	bool deterministic = true;
+	bool batchRunning = false;
+	size_t boxHits = 0;
+
+	//loading / streaming
+	bool importing = false;
+	float importProgress = 0.0f;
+	size_t imported = 0;
+	bool streaming = false;
+	uint64_t streamReceived = 0;
+	size_t streamQueued = 0;
+	size_t streamCapacity = 0;
+
+	double tickMilliseconds = 0.0; //how long the update thread worked on this one
+};
+
+
+// Runs the Scene on its own thread, so imports, streams, calculator updates and BVH builds never hold up a frame.
+// The render thread only talks to it in two ways: post()ed commands, which run on the update thread before its
+// next tick, and snapshots, published through a triple buffer after every tick that changed something. The render
+// thread takes the newest one each frame and never waits for the update thread, the update thread never waits
+// for a frame. Ticks come every BUSY_TICK while something is going on, otherwise when a command arrives.
+//   updater.post([handle](Scene& scene) { scene.remove(handle); });
+//   if (updater.fetch()) { apply(updater.snapshot()); updater.confirm(lastSequence); }
+class SceneUpdater {
+public:
+	using Command = std::function<void(Scene&)>;
+
+	static constexpr double BUSY_TICK = 0.002; //seconds between ticks while importing, streaming, ... (see Scene::busy)
+	static constexpr double IDLE_TICK = 0.1; //otherwise, commands wake it up anyway
+	static constexpr double PROGRESS_INTERVAL = 0.1; //while importing, the progress is published this often even if nothing else changed
+
+	explicit SceneUpdater(TaskPool* pool)
+		: m_scene{ pool } {
+	};
+
+	~SceneUpdater() {
+		stop();
+	};
+
+	SceneUpdater(const SceneUpdater&) = delete;
+	SceneUpdater& operator=(const SceneUpdater&) = delete;
+
+
+	//set up the scene through this before start(), after that only commands touch it
+	Scene& scene() { return m_scene; }
+
+	void start() {
+		m_thread = std::thread(&SceneUpdater::run, this);
+	};
+
+	void stop() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_one();
+		if (m_thread.joinable()) {
+			m_thread.join();
+		}
+	};
+
+
+	//any thread: runs on the update thread before its next tick, in the order they were posted
+	void post(Command command) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_commands.push_back(std::move(command));
+		}
+		m_wake.notify_one();
+	};
+
+
+	//render thread: moves snapshot() to the newest one, false if nothing new was published
+	bool fetch() { return m_snapshots.fetch(); }
+	bool fresh() const { return m_snapshots.fresh(); }
+	const SceneSnapshot& snapshot() const { return m_snapshots.front(); }
+
+	//render thread: every delta up to sequence was applied, the next snapshots leave them out
+	void confirm(uint64_t sequence) {
+		m_confirmed.store(sequence, std::memory_order_release);
+	};
+
+
+
+private:
+	Scene m_scene;
+	TripleBuffer<SceneSnapshot> m_snapshots;
+	std::thread m_thread;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::vector<Command> m_commands;
+	bool m_stop = false;
+
+	//update thread only
+	std::deque<std::shared_ptr<const VectorDelta>> m_unconfirmed;
+	uint64_t m_sequence = 0;
+	uint64_t m_ticks = 0;
+	double m_lastPublish = 0.0;
+	bool m_importing = false; //as last published
+	bool m_streaming = false;
+	std::atomic<uint64_t> m_confirmed{ 0 };
+
+
+	void run() {
+		std::vector<Command> commands;
+		bool first = true;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				double wait = m_scene.busy() ? BUSY_TICK : IDLE_TICK;
+				m_wake.wait_for(lock, std::chrono::duration<double>(wait), [&] { return m_stop || !m_commands.empty() || first; });
+				if (m_stop) {
+					break;
+				}
+				commands.swap(m_commands);
+			}
+
+			double start = seconds();
+			bool changed = !commands.empty() || first;
+			for (Command& command : commands) {
+				command(m_scene);
+			}
+			commands.clear();
+			changed = m_scene.update() || changed;
+
+			//an import or stream starting / ending shows too, even in a tick that brought nothing
+			double now = seconds();
+			bool importing = m_scene.importer.busy();
+			changed = changed || importing != m_importing || m_scene.stream.running() != m_streaming;
+			if (changed || (importing && now - m_lastPublish > PROGRESS_INTERVAL)) {
+				publish((now - start) * 1000.0);
+				m_lastPublish = now;
+				first = false;
+			}
+		}
+	};
+
+	void publish(double milliseconds) {
+		std::shared_ptr<VectorDelta> delta = m_scene.takeDelta();
+		if (delta) {
+			delta->sequence = ++m_sequence;
+			m_unconfirmed.push_back(std::move(delta));
+		}
+		uint64_t confirmed = m_confirmed.load(std::memory_order_acquire);
+		while (!m_unconfirmed.empty() && m_unconfirmed.front()->sequence <= confirmed) {
+			m_unconfirmed.pop_front();
+		}
+
+		//the slot still holds an older snapshot, every field is written again
+		SceneSnapshot& snapshot = m_snapshots.back();
+		const Calculator& calculator = m_scene.calculator;
+		snapshot.tick = ++m_ticks;
+		snapshot.deltas.assign(m_unconfirmed.begin(), m_unconfirmed.end());
+		snapshot.bvh = m_scene.bvh();
+		snapshot.batch = m_scene.batch();
+		snapshot.transformed = m_scene.transformed();
+
+		snapshot.results.resize(calculator.results().size());
+		for (size_t r = 0; r < snapshot.results.size(); ++r) {
+			snapshot.results[r] = calculator.resultValue(r);
+		}
+		snapshot.scalarResults.resize(calculator.scalarResults().size());
+		for (size_t d = 0; d < snapshot.scalarResults.size(); ++d) {
+			snapshot.scalarResults[d] = calculator.graph().scalarValue(calculator.scalarResults()[d]);
+		}
+		snapshot.matrices = calculator.matrices();
+		snapshot.current = calculator.describeCurrent();
+		snapshot.chain = calculator.describeChain();
+		snapshot.last = calculator.history().empty() ? std::string() : calculator.history().back().text;
+		snapshot.operation = calculator.current().op;
+		snapshot.chainMatrix = calculator.chainMatrix();
+		snapshot.deterministic = calculator.reductionMode() == kernels::ReductionMode::DETERMINISTIC;
+		snapshot.batchRunning = calculator.batchRunning();
+		snapshot.boxHits = m_scene.boxHits();
+
+		snapshot.importing = m_importing = m_scene.importer.busy();
+		snapshot.importProgress = m_scene.importer.progress();
+		snapshot.imported = m_scene.importer.parsed();
+		snapshot.streaming = m_streaming = m_scene.stream.running();
+		snapshot.streamReceived = m_scene.stream.received();
+		snapshot.streamQueued = m_scene.stream.queued();
+		snapshot.streamCapacity = m_scene.stream.capacity();
+
+		snapshot.tickMilliseconds = milliseconds;
+		m_snapshots.publish();
+
+		//the render loop may be asleep in glfwWaitEvents (see framePacer.h)
+		glfwPostEmptyEvent();
+	};
+
+	static double seconds() {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	};
+};
@@ -2,11 +2,47 @@
 #define SHADER_H
 
 #include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <filesystem>
+#include <iterator>
+#include <system_error>
+
+// program binaries: core since 4.1, ARB_get_program_binary on older contexts (only if glad was generated with it)
+#if defined(GL_VERSION_4_1) || defined(GL_ARB_get_program_binary)
+#define SHADER_BINARY_CACHE 1
+#endif
+
+
+// Name of a uniform, hashed once (FNV-1a). Only a constexpr one is hashed at compile time, declare the names next
+// to where they are set, e.g. static constexpr UniformId uModel("model"); and the setters never touch strings.
+// A bare literal still works but hashes on every call.
+struct UniformId {
+    uint32_t hash;
+
+    constexpr UniformId(const char* name) : hash{ fnv1a(name) } {}
+    UniformId(const std::string& name) : hash{ fnv1a(name.c_str()) } {}
+
+    static constexpr uint32_t fnv1a(const char* name) {
+        uint32_t h = 2166136261u;
+        for (; *name != '\0'; ++name) {
+            h = (h ^ (uint8_t)*name) * 16777619u;
+        }
+        return h;
+    }
+};
+
 
 class Shader {
 
@@ -17,6 +53,14 @@ public:
     Shader(const char* vertexPath, const char* fragmentPath) {
         std::string vertexCode;
         std::string fragmentCode;
+        readSources(vertexPath, fragmentPath, vertexCode, fragmentCode);
+
+        ID = buildProgram(vertexCode, fragmentCode, std::string(vertexPath) + " + " + fragmentPath);
+        reflectUniforms();
+    };
+
+
+    static bool readSources(const char* vertexPath, const char* fragmentPath, std::string& vertexCode, std::string& fragmentCode) {
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
         // ensure ifstream objects can throw exceptions:
@@ -38,11 +82,60 @@ public:
             vertexCode = vShaderStream.str();
             fragmentCode = fShaderStream.str();
         }
-        catch (std::ifstream::failure e)
+        catch (const std::ifstream::failure&)
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            return false;
+        }
+        return true;
+
+    }
+
+
+    // links a program from source, going through the on-disk binary cache when the driver supports it
+    // prints one timing line per program so startup cost is visible
+    static unsigned int buildProgram(const std::string& vertexCode, const std::string& fragmentCode, const std::string& label, bool* linkedOut = nullptr) {
+        auto start = std::chrono::high_resolution_clock::now();
+        bool linked = false;
+        const char* result = "COMPILED";
+
+        unsigned int program = 0;
+#ifdef SHADER_BINARY_CACHE
+        bool cacheUsable = binaryCacheSupported();
+        uint64_t key = 0;
+        if (cacheUsable) {
+            key = cacheKey(vertexCode, fragmentCode);
+            program = loadCachedProgram(key);
+            if (program != 0) {
+                linked = true;
+                result = "CACHE_HIT";
+            }
+            else {
+                result = "CACHE_MISS";
+            }
         }
+#endif
 
+        if (program == 0) {
+            program = compileProgram(vertexCode, fragmentCode, linked);
+#ifdef SHADER_BINARY_CACHE
+            if (cacheUsable && linked) {
+                saveCachedProgram(key, program);
+            }
+#endif
+        }
+
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << "SHADER::" << result << " " << label << " (" << ms << " ms)" << std::endl;
+
+        if (linkedOut != nullptr) {
+            *linkedOut = linked;
+        }
+        return program;
+    }
+
+
+    static unsigned int compileProgram(const std::string& vertexCode, const std::string& fragmentCode, bool& linked) {
         // so this is the GLSL code
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
@@ -81,28 +174,191 @@ public:
         if (!success)
         {
             glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+            std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
         }
 
         //NOW WE HAVE TO LINK THE SHADERS INTO A SHADER PROGRAM
         //we have to activate this before rendeing object
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
+        unsigned int program = glCreateProgram();
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+#ifdef SHADER_BINARY_CACHE
+        // ask the driver to keep the linked binary around so we can cache it
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+        glLinkProgram(program);
 
         // check if no linking errors
-        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
         if (!success) {
-            glGetProgramInfoLog(ID, 512, NULL, infoLog);
+            glGetProgramInfoLog(program, 512, NULL, infoLog);
             std::cout << "ERROR::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
         }
+        linked = success != 0;
         //JUST CLEANING
         glDeleteShader(vertex); // NO NEED AFTER LINK success
         glDeleteShader(fragment);
 
+        return program;
+    }
+
+
+    // where program binaries are kept, relative to the working directory like the shader files
+    static std::string& cacheDirectory() {
+        static std::string directory = "shadercache";
+        return directory;
+    }
+
+
+#ifdef SHADER_BINARY_CACHE
+    // glGetProgramBinary is core in 4.1 and an extension on our 3.3 context
+    static bool binaryCacheSupported() {
+        static int formats = -1;
+        if (formats < 0) {
+            formats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            glGetError(); // drivers without the extension report INVALID_ENUM here
+        }
+        return formats > 0;
+    }
+
+    // binaries only load on the exact same driver, so the driver strings are part of the key
+    static uint64_t cacheKey(const std::string& vertexCode, const std::string& fragmentCode) {
+        uint64_t h = 14695981039346656037ull;
+        auto mix = [&h](const char* data, size_t size) {
+            for (size_t i = 0; i < size; ++i) {
+                h = (h ^ (uint8_t)data[i]) * 1099511628211ull;
+            }
+            h = (h ^ 0xFF) * 1099511628211ull; // separator so "ab"+"c" != "a"+"bc"
+        };
+        mix(vertexCode.data(), vertexCode.size());
+        mix(fragmentCode.data(), fragmentCode.size());
+        const GLenum driverStrings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+        for (GLenum name : driverStrings) {
+            const char* value = (const char*)glGetString(name);
+            if (value != NULL) {
+                mix(value, std::strlen(value));
+            }
+        }
+        return h;
+    }
 
+    static std::string cachePath(uint64_t key) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return (std::filesystem::path(cacheDirectory()) / name).string();
+    }
+
+    struct BinaryHeader {
+        uint32_t magic;
+        uint32_t format;
+        uint64_t key;
     };
+    static const uint32_t binaryMagic = 0x50524742; // "BGRP"
+
+    // returns 0 when there is no usable binary, the caller then compiles from source
+    static unsigned int loadCachedProgram(uint64_t key) {
+        std::ifstream file(cachePath(key), std::ios::binary);
+        if (!file) {
+            return 0;
+        }
+        BinaryHeader header;
+        if (!file.read((char*)&header, sizeof(header)) || header.magic != binaryMagic || header.key != key) {
+            return 0;
+        }
+        std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (binary.empty()) {
+            return 0;
+        }
+
+        unsigned int program = glCreateProgram();
+        glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+
+        // a driver update can reject old binaries, that just counts as a miss
+        int success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+
+    static void saveCachedProgram(uint64_t key, unsigned int program) {
+        int length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) {
+            return;
+        }
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, &length, &format, binary.data());
+
+        std::error_code error;
+        std::filesystem::create_directories(cacheDirectory(), error);
+
+        std::ofstream file(cachePath(key), std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cout << "ERROR::SHADER::CACHE_NOT_WRITABLE " << cachePath(key) << std::endl;
+            return;
+        }
+        BinaryHeader header{ binaryMagic, format, key };
+        file.write((const char*)&header, sizeof(header));
+        file.write(binary.data(), length);
+    }
+#endif
+
+    // looks up every active uniform once after linking, so the setters never call glGetUniformLocation
+    void reflectUniforms() {
+        uniforms.clear();
+
+        int count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+
+        char name[256];
+        for (int i = 0; i < count; ++i) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, sizeof(name), &length, &size, &type, name);
+
+            // arrays are reported as "name[0]", we set them through the base name
+            std::string uniformName(name, length);
+            size_t bracket = uniformName.find('[');
+            if (bracket != std::string::npos) {
+                uniformName.erase(bracket);
+            }
+
+            // members of uniform blocks have no location
+            int location = glGetUniformLocation(ID, uniformName.c_str());
+            if (location < 0) {
+                continue;
+            }
+            uniforms.push_back({ UniformId(uniformName).hash, location });
+        }
+
+        std::sort(uniforms.begin(), uniforms.end(), [](const UniformSlot& a, const UniformSlot& b) { return a.hash < b.hash; });
+        for (size_t i = 1; i < uniforms.size(); ++i) {
+            if (uniforms[i].hash == uniforms[i - 1].hash) {
+                std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION" << std::endl;
+            }
+        }
+    }
+
+    // -1 if the program has no such active uniform (glUniform* ignores -1, same as before)
+    int location(UniformId id) const {
+        auto it = std::lower_bound(uniforms.begin(), uniforms.end(), id.hash,
+            [](const UniformSlot& slot, uint32_t hash) { return slot.hash < hash; });
+        return (it != uniforms.end() && it->hash == id.hash) ? it->location : -1;
+    }
+
+    // points a named std140 block of this program at a uniform buffer binding point
+    void bindUniformBlock(const char* blockName, unsigned int binding) const {
+        unsigned int index = glGetUniformBlockIndex(ID, blockName);
+        if (index != GL_INVALID_INDEX) {
+            glUniformBlockBinding(ID, index, binding);
+        }
+    }
 
     void use() {
         glUseProgram(ID); //ACTIVATE THE PROGRAM == rendering object (use the shaders)
@@ -110,22 +366,35 @@ public:
 
 
     //FOR SETTING UNIFORMS
-    void setBool(const std::string& name, bool value) const
+    void setBool(UniformId name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(location(name), (int)value);
     }
-    void setInt(const std::string& name, int value) const
+    void setInt(UniformId name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(location(name), value);
     }
-    void setFloat(const std::string& name, float value) const
+    void setFloat(UniformId name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(location(name), value);
     }
 
-    void setMat4(const std::string& name, glm::mat4 value) const {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+    void setVec3(UniformId name, const glm::vec3& value) const
+    {
+        glUniform3fv(location(name), 1, glm::value_ptr(value));
     }
+
+    void setMat4(UniformId name, const glm::mat4& value) const {
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, glm::value_ptr(value));
+    }
+
+private:
+    struct UniformSlot {
+        uint32_t hash;
+        int location;
+    };
+
+    std::vector<UniformSlot> uniforms; // sorted by hash
 };
 
 
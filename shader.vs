@@ -1,12 +1,16 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aColor;
+layout (location = 1) in vec4 aColor; // packed RGBA8, normalized by the attribute setup
 
 
 uniform mat4 transform;
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera
+{
+   mat4 view;
+   mat4 projection;
+   vec4 cameraPosition;
+};
 
 out vec3 vecColor;
 
@@ -15,5 +19,5 @@ out vec3 vecColor;
 void main()
 {
    gl_Position = projection * view * model * vec4(aPos.x, aPos.y, aPos.z, 1.0f);
-   vecColor = aColor;
+   vecColor = aColor.rgb;
 }
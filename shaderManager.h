@@ -0,0 +1,317 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <system_error>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "shader.h"
+
+// Owns every shader program and reloads them while the app runs.
+// A background thread watches the source files (inotify on Linux, timestamps elsewhere), recompiles a changed
+// program on its own context that shares objects with the main window, and hands the new program over.
+// The render thread swaps it in at the start of the next frame, and only if it linked, so a typo never kills the view.
+class ShaderManager {
+public:
+	//onLink runs on the render thread for every program that was (re)linked, e.g. to bind uniform blocks again
+	ShaderManager(GLFWwindow* mainWindow, std::function<void(Shader&)> onLink = nullptr)
+		: m_onLink{ onLink } {
+		if (mainWindow == nullptr) {
+			return;
+		}
+		//invisible 1x1 window whose context shares programs with the main one, current only on the watcher thread
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		m_compileWindow = glfwCreateWindow(1, 1, "shader compiler", NULL, mainWindow);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+		if (m_compileWindow == nullptr) {
+			std::cout << "SHADER::MANAGER no shared context, reloads compile on the render thread\n";
+		}
+	};
+
+	~ShaderManager() {
+		shutdown();
+	};
+
+	ShaderManager(const ShaderManager&) = delete;
+	ShaderManager& operator=(const ShaderManager&) = delete;
+
+
+	//compiles right away (we need it for the first frame), the reference stays valid across reloads
+	Shader& load(const std::string& name, const char* vertexPath, const char* fragmentPath) {
+		std::unique_ptr<Program> program(new Program());
+		program->name = name;
+		program->vertexPath = vertexPath;
+		program->fragmentPath = fragmentPath;
+		program->shader.reset(new Shader(vertexPath, fragmentPath));
+		program->vertexTime = writeTime(program->vertexPath);
+		program->fragmentTime = writeTime(program->fragmentPath);
+
+		if (m_onLink) {
+			m_onLink(*program->shader);
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_programs.push_back(std::move(program));
+		return *m_programs.back()->shader;
+	};
+
+	Shader* get(const std::string& name) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto& program : m_programs) {
+			if (program->name == name) {
+				return program->shader.get();
+			}
+		}
+		return nullptr;
+	};
+
+
+	//starts the watcher thread, call after all programs are loaded
+	void startWatching() {
+		if (m_running) {
+			return;
+		}
+		m_running = true;
+		m_watcher = std::thread(&ShaderManager::watch, this);
+	};
+
+
+	//render thread, once per frame before anything is drawn: swaps in programs that finished compiling
+	void beginFrame() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto& program : m_programs) {
+			if (program->needsCompile) {
+				//no shared context, so the render thread does the compile itself
+				program->needsCompile = false;
+				compile(*program);
+			}
+			if (!program->staged) {
+				continue;
+			}
+			program->staged = false;
+
+			if (!program->stagedLinked) {
+				glDeleteProgram(program->stagedID);
+				std::cout << "SHADER::RELOAD_FAILED " << program->name << ", keeping the old program" << std::endl;
+				continue;
+			}
+
+			Shader& shader = *program->shader;
+			glDeleteProgram(shader.ID);
+			shader.ID = program->stagedID;
+			shader.reflectUniforms();
+			if (m_onLink) {
+				m_onLink(shader);
+			}
+			std::cout << "SHADER::RELOADED " << program->name << std::endl;
+		}
+	};
+
+
+	//an edited program waits for beginFrame, an idle render loop has to run a frame (see framePacer.h)
+	bool reloadPending() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto& program : m_programs) {
+			if (program->needsCompile || program->staged) {
+				return true;
+			}
+		}
+		return false;
+	};
+
+
+	//joins the watcher and drops the shared context, must run before glfwTerminate
+	void shutdown() {
+		if (m_running) {
+			m_running = false;
+			m_watcher.join();
+		}
+		if (m_compileWindow != nullptr) {
+			glfwDestroyWindow(m_compileWindow);
+			m_compileWindow = nullptr;
+		}
+	};
+
+
+
+private:
+	struct Program {
+		std::string name;
+		std::string vertexPath;
+		std::string fragmentPath;
+		std::unique_ptr<Shader> shader;
+
+		std::filesystem::file_time_type vertexTime;
+		std::filesystem::file_time_type fragmentTime;
+
+		bool needsCompile = false; //changed, waiting for the render thread (no shared context)
+		bool staged = false;       //compiled, waiting for beginFrame to swap it in
+		bool stagedLinked = false;
+		unsigned int stagedID = 0;
+	};
+
+	std::vector<std::unique_ptr<Program>> m_programs;
+	std::function<void(Shader&)> m_onLink;
+
+	GLFWwindow* m_compileWindow = nullptr;
+	std::thread m_watcher;
+	std::atomic<bool> m_running{ false };
+	std::mutex m_mutex; //guards m_programs and the staged fields
+
+
+	static std::filesystem::file_time_type writeTime(const std::string& path) {
+		std::error_code error;
+		return std::filesystem::last_write_time(path, error);
+	};
+
+
+	//builds a fresh program from the files, never touches the one that is currently drawing
+	//0 if the sources could not be read (editors sometimes leave the file empty for a moment, the next write triggers again)
+	static unsigned int build(const Program& program, bool& linked) {
+		std::string vertexCode;
+		std::string fragmentCode;
+		if (!Shader::readSources(program.vertexPath.c_str(), program.fragmentPath.c_str(), vertexCode, fragmentCode)) {
+			return 0;
+		}
+		return Shader::buildProgram(vertexCode, fragmentCode, program.name, &linked);
+	};
+
+	//caller holds m_mutex
+	static void stage(Program& program, unsigned int id, bool linked) {
+		if (program.staged) {
+			glDeleteProgram(program.stagedID); //an even newer edit beat the swap
+		}
+		program.stagedID = id;
+		program.stagedLinked = linked;
+		program.staged = true;
+	};
+
+	void compile(Program& program) {
+		bool linked = false;
+		unsigned int id = build(program, linked);
+		if (id != 0) {
+			stage(program, id, linked);
+		}
+	};
+
+
+	//marks every program using one of the changed files and compiles them (on the shared context if we have one)
+	void rebuildChanged() {
+		std::vector<Program*> changed;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (auto& program : m_programs) {
+				auto vertexTime = writeTime(program->vertexPath);
+				auto fragmentTime = writeTime(program->fragmentPath);
+				if (vertexTime != program->vertexTime || fragmentTime != program->fragmentTime) {
+					program->vertexTime = vertexTime;
+					program->fragmentTime = fragmentTime;
+					changed.push_back(program.get());
+				}
+			}
+		}
+		if (changed.empty()) {
+			return;
+		}
+
+		if (m_compileWindow == nullptr) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (Program* program : changed) {
+				program->needsCompile = true;
+			}
+			glfwPostEmptyEvent(); //wakes a render loop that waits for events
+			return;
+		}
+
+		for (Program* program : changed) {
+			bool linked = false;
+			unsigned int id = build(*program, linked);
+			if (id == 0) {
+				continue;
+			}
+			//the render thread must see a finished program
+			glFinish();
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			stage(*program, id, linked);
+		}
+		glfwPostEmptyEvent();
+	};
+
+
+	void watch() {
+		if (m_compileWindow != nullptr) {
+			glfwMakeContextCurrent(m_compileWindow);
+		}
+
+#ifdef __linux__
+		//watch the folders, editors often save by writing a new file and renaming it over the old one
+		int fd = inotify_init1(IN_NONBLOCK);
+		if (fd >= 0) {
+			std::vector<std::string> folders;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				for (auto& program : m_programs) {
+					for (const std::string* path : { &program->vertexPath, &program->fragmentPath }) {
+						std::string folder = std::filesystem::path(*path).parent_path().string();
+						if (folder.empty()) {
+							folder = ".";
+						}
+						if (std::find(folders.begin(), folders.end(), folder) == folders.end()) {
+							folders.push_back(folder);
+						}
+					}
+				}
+			}
+			for (const std::string& folder : folders) {
+				inotify_add_watch(fd, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+			}
+			//anything saved between load() and now produced no event
+			rebuildChanged();
+
+			char events[4096];
+			while (m_running) {
+				pollfd descriptor{ fd, POLLIN, 0 };
+				if (poll(&descriptor, 1, 200) <= 0) {
+					continue;
+				}
+				//let a burst of writes from one save settle, then drain it
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				while (read(fd, events, sizeof(events)) > 0) {}
+
+				rebuildChanged();
+			}
+			close(fd);
+		}
+		else
+#endif
+		{
+			//portable fallback: compare timestamps a few times a second
+			while (m_running) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(250));
+				rebuildChanged();
+			}
+		}
+
+		if (m_compileWindow != nullptr) {
+			glfwMakeContextCurrent(NULL);
+		}
+	};
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <algorithm>
+
+// Lock-free single producer / single consumer ring buffer.
+// One thread only pushes, one other thread only pops. Head and tail only ever grow (the slot is index & mask),
+// each side keeps a cached copy of the other side's index and only re-reads the atomic when the cache says
+// full / empty, so a busy ring costs about one shared cache line transfer per batch, not per item.
+template <typename T>
+class SpscRing {
+public:
+	//capacity is rounded up to a power of two
+	explicit SpscRing(size_t capacity) {
+		size_t size = 1;
+		while (size < capacity) {
+			size *= 2;
+		}
+		m_items.resize(size);
+		m_mask = size - 1;
+	};
+
+	SpscRing(const SpscRing&) = delete;
+	SpscRing& operator=(const SpscRing&) = delete;
+
+
+	//producer: copies as many as fit, returns how many that was
+	size_t push(const T* items, size_t count) {
+		size_t head = m_head.load(std::memory_order_relaxed);
+		size_t free = m_items.size() - (head - m_cachedTail);
+		if (free < count) {
+			m_cachedTail = m_tail.load(std::memory_order_acquire);
+			free = m_items.size() - (head - m_cachedTail);
+		}
+		count = std::min(count, free);
+		for (size_t i = 0; i < count; ++i) {
+			m_items[(head + i) & m_mask] = items[i];
+		}
+		m_head.store(head + count, std::memory_order_release);
+		return count;
+	};
+
+	//consumer: takes up to max items into out, returns how many
+	size_t pop(T* out, size_t max) {
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		size_t count = available(tail, max);
+		for (size_t i = 0; i < count; ++i) {
+			out[i] = m_items[(tail + i) & m_mask];
+		}
+		m_tail.store(tail + count, std::memory_order_release);
+		return count;
+	};
+
+	//consumer: appends up to max items to out, only the ones taken are written (in at most two block copies)
+	size_t pop(std::vector<T>& out, size_t max) {
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		size_t count = available(tail, max);
+		size_t begin = tail & m_mask;
+		size_t first = std::min(count, m_items.size() - begin);
+		out.insert(out.end(), m_items.begin() + begin, m_items.begin() + begin + first);
+		out.insert(out.end(), m_items.begin(), m_items.begin() + (count - first));
+		m_tail.store(tail + count, std::memory_order_release);
+		return count;
+	};
+
+	//a snapshot, only exact when neither side is busy. Tail first: the head read after it can only be further on,
+	//the other way round the consumer may pass the head in between and the difference wraps around
+	size_t size() const {
+		size_t tail = m_tail.load(std::memory_order_acquire);
+		return m_head.load(std::memory_order_acquire) - tail;
+	};
+	size_t capacity() const { return m_items.size(); }
+
+
+
+private:
+	std::vector<T> m_items;
+	size_t m_mask = 0;
+
+	//producer side
+	alignas(64) std::atomic<size_t> m_head{ 0 };
+	size_t m_cachedTail = 0;
+
+	//consumer side
+	alignas(64) std::atomic<size_t> m_tail{ 0 };
+	size_t m_cachedHead = 0;
+
+
+	//consumer: how many of max can be taken from tail on
+	size_t available(size_t tail, size_t max) {
+		size_t count = m_cachedHead - tail;
+		if (count < max) {
+			m_cachedHead = m_head.load(std::memory_order_acquire);
+			count = m_cachedHead - tail;
+		}
+		return std::min(max, count);
+	};
+};
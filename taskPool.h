@@ -0,0 +1,167 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+// Work-stealing thread pool.
+// Every worker has its own deque: it pushes and pops at the back (newest first, still warm in cache) and idle
+// workers steal from the front of the others (oldest first, usually the biggest pieces). parallelFor() cuts a
+// range into chunks and the calling thread helps run them while it waits, so it can be called from a task too.
+class TaskPool {
+public:
+	//threads = 0 picks one less than the number of cores (the render thread keeps one)
+	explicit TaskPool(unsigned int threads = 0) {
+		if (threads == 0) {
+			unsigned int cores = std::thread::hardware_concurrency();
+			threads = cores > 1 ? cores - 1 : 1;
+		}
+		for (unsigned int i = 0; i < threads; ++i) {
+			m_queues.emplace_back(new Queue());
+		}
+		for (unsigned int i = 0; i < threads; ++i) {
+			m_threads.emplace_back(&TaskPool::workerLoop, this, i);
+		}
+	};
+
+	~TaskPool() {
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_stopping = true;
+		}
+		m_wake.notify_all();
+		for (std::thread& thread : m_threads) {
+			thread.join();
+		}
+	};
+
+	TaskPool(const TaskPool&) = delete;
+	TaskPool& operator=(const TaskPool&) = delete;
+
+	size_t workerCount() const { return m_threads.size(); }
+
+
+	//fire and forget
+	void submit(std::function<void()> task) {
+		size_t queue = t_workerIndex < m_queues.size() && t_pool == this ? t_workerIndex : m_nextQueue++ % m_queues.size();
+		{
+			std::lock_guard<std::mutex> lock(m_queues[queue]->mutex);
+			m_queues[queue]->tasks.push_back(std::move(task));
+		}
+		m_pending++;
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+		}
+		m_wake.notify_one();
+	};
+
+
+	//calls body(begin, end) for chunks of at most `grain` items covering [0, count) and returns when all are done
+	template<typename Body>
+	void parallelFor(size_t count, size_t grain, Body body) {
+		if (count == 0) {
+			return;
+		}
+		grain = std::max<size_t>(grain, 1);
+		size_t chunks = (count + grain - 1) / grain;
+		if (chunks == 1) {
+			body((size_t)0, count);
+			return;
+		}
+
+		auto remaining = std::make_shared<std::atomic<size_t>>(chunks);
+		//the first chunk runs right here
+		for (size_t chunk = 1; chunk < chunks; ++chunk) {
+			size_t begin = chunk * grain;
+			size_t end = std::min(begin + grain, count);
+			submit([remaining, body, begin, end]() {
+				body(begin, end);
+				(*remaining)--;
+			});
+		}
+		body((size_t)0, std::min(grain, count));
+		(*remaining)--;
+
+		//help instead of blocking, nested parallelFor calls on workers can't deadlock this way
+		while (remaining->load() > 0) {
+			if (!runOne(t_pool == this ? t_workerIndex : NO_WORKER)) {
+				std::this_thread::yield();
+			}
+		}
+	};
+
+
+
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	static constexpr size_t NO_WORKER = (size_t)-1;
+
+	std::vector<std::unique_ptr<Queue>> m_queues;
+	std::vector<std::thread> m_threads;
+	std::atomic<size_t> m_nextQueue{ 0 };
+	std::atomic<size_t> m_pending{ 0 };
+
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+	bool m_stopping = false;
+
+	//which worker (of which pool) the current thread is
+	static inline thread_local size_t t_workerIndex = NO_WORKER;
+	static inline thread_local TaskPool* t_pool = nullptr;
+
+
+	//own queue from the back, then everybody else's from the front
+	bool runOne(size_t self) {
+		std::function<void()> task;
+		if (self < m_queues.size()) {
+			Queue& own = *m_queues[self];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.tasks.empty()) {
+				task = std::move(own.tasks.back());
+				own.tasks.pop_back();
+			}
+		}
+		if (!task) {
+			size_t start = self < m_queues.size() ? self + 1 : 0;
+			for (size_t i = 0; i < m_queues.size() && !task; ++i) {
+				Queue& victim = *m_queues[(start + i) % m_queues.size()];
+				std::lock_guard<std::mutex> lock(victim.mutex);
+				if (!victim.tasks.empty()) {
+					task = std::move(victim.tasks.front());
+					victim.tasks.pop_front();
+				}
+			}
+		}
+		if (!task) {
+			return false;
+		}
+		m_pending--;
+		task();
+		return true;
+	};
+
+	void workerLoop(size_t index) {
+		t_workerIndex = index;
+		t_pool = this;
+		while (true) {
+			if (runOne(index)) {
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(m_sleepMutex);
+			m_wake.wait(lock, [this] { return m_stopping || m_pending.load() > 0; });
+			if (m_stopping && m_pending.load() == 0) {
+				return;
+			}
+		}
+	};
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free triple buffer: one thread writes whole values, one other thread reads the newest one.
+// The writer fills back() and publish()es it, the reader fetch()es and keeps using front() until its next fetch.
+// Three slots, so neither side ever waits: the writer always has a slot the reader can't be in, and a value
+// the reader hasn't fetched yet is simply replaced by a newer one (the reader only ever sees the latest).
+// The middle slot's index and a fresh bit share one atomic byte, each hand over is a single exchange.
+//   writer: buffer.back() = ...; buffer.publish();
+//   reader: if (buffer.fetch()) { use(buffer.front()); }
+template <typename T>
+class TripleBuffer {
+public:
+	TripleBuffer() = default;
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+
+	//writer: the slot to fill, it still holds whatever was written into it two publishes ago
+	T& back() { return m_slots[m_back].value; }
+
+	//writer: hands back() over and gets the old middle slot to fill next
+	void publish() {
+		uint8_t old = m_middle.exchange((uint8_t)(m_back | FRESH), std::memory_order_acq_rel);
+		m_back = old & INDEX;
+	};
+
+
+	//reader: takes the newest published value, false (front() unchanged) if there is none it hasn't seen
+	bool fetch() {
+		if (!fresh()) {
+			return false;
+		}
+		uint8_t old = m_middle.exchange(m_front, std::memory_order_acq_rel);
+		m_front = old & INDEX;
+		return true;
+	};
+
+	//reader: a value was published since the last fetch
+	bool fresh() const { return (m_middle.load(std::memory_order_acquire) & FRESH) != 0; }
+
+	const T& front() const { return m_slots[m_front].value; }
+
+
+
+private:
+	static constexpr uint8_t INDEX = 3;
+	static constexpr uint8_t FRESH = 4;
+
+	//own cache lines, the two sides never write to the same one
+	struct alignas(64) Slot {
+		T value;
+	};
+
+	Slot m_slots[3];
+	alignas(64) std::atomic<uint8_t> m_middle{ 2 };
+	alignas(64) uint8_t m_back = 0; //writer only
+	alignas(64) uint8_t m_front = 1; //reader only
+};
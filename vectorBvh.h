@@ -0,0 +1,551 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <atomic>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+#include "vectorKernels.h"
+#include "taskPool.h"
+
+// Bounding volume hierarchy over the user arrows, for CPU queries that must not scan every vector:
+// what's under a ray (hover), which vectors are inside a box (calculator selection), which one is nearest.
+// A primitive is the segment from the origin to the vector's tip (every user arrow starts at the origin), the
+// primitive index is the vector's dense index in the store. Nodes keep the box around their tips, the box around
+// their arrows is that plus the origin, so box queries get the tight one and rays / distances the full one.
+//
+// build() is a binned SAH builder: every node tries BINS buckets along each axis and keeps the cheapest split by
+// surface area, ranges of more than PARALLEL_MIN vectors are binned and split on the task pool. The primitives
+// are partitioned in place, so every pass and every leaf reads them front to back.
+// refit() follows a single edited vector up to the root without rebuilding, adding or removing vectors changes
+// the dense indices and needs a build(). Refits keep the tree's shape, so the boxes drift apart from the SAH
+// split they were made for; needsRebuild() says when a rebuild is worth it again.
+class VectorBvh {
+public:
+	static constexpr size_t NOT_FOUND = (size_t)-1;
+
+	struct Node {
+		glm::vec3 min; //around the tips below
+		uint32_t first; //leaf: first primitive, inner: left child (the right one follows it)
+		glm::vec3 max;
+		uint32_t count; //primitives in a leaf, 0 for inner nodes
+	};
+	static_assert(sizeof(Node) == 32, "two nodes per cache line");
+
+	static constexpr int BINS = 16;
+	static constexpr uint32_t MAX_LEAF = 8;
+	static constexpr int MAX_DEPTH = 64; //deeper ranges become (big) leaves, keeps the query stacks fixed
+	static constexpr uint32_t PARALLEL_MIN = 1 << 15;
+
+	VectorBvh() = default;
+
+	//flat copies of the arrays, for refitting a copy while the original is still being queried elsewhere
+	VectorBvh(const VectorBvh& other)
+		: m_nodes{ other.m_nodes }, m_parents{ other.m_parents }, m_prims{ other.m_prims }, m_slotOf{ other.m_slotOf },
+		m_leafOf{ other.m_leafOf }, m_nodeCount{ other.m_nodeCount.load() }, m_refits{ other.m_refits } {
+	};
+
+
+	//pool is optional, without one everything is built on the calling thread
+	void build(const VectorArrays& tips, TaskPool* pool = nullptr) {
+		size_t count = tips.size();
+		m_prims.resize(count);
+		m_slotOf.resize(count);
+		m_leafOf.resize(count);
+		m_nodes.clear();
+		m_parents.clear();
+		m_refits = 0;
+		if (count == 0) {
+			return;
+		}
+		m_nodes.resize(2 * count - 1);
+		m_parents.resize(2 * count - 1);
+		m_pool = pool;
+
+		forRange(0, (uint32_t)count, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; ++i) {
+				m_prims[i] = Prim{ tips.get(i), i };
+			}
+		});
+		m_nodeCount = 1;
+		m_parents[0] = 0;
+		buildNode(0, 0, (uint32_t)count, 0, bounds(0, (uint32_t)count));
+		m_nodes.resize(m_nodeCount);
+		m_parents.resize(m_nodeCount);
+		m_pool = nullptr;
+	};
+
+	//vector i moved to tip, its leaf and the boxes above it follow
+	void refit(size_t i, const glm::vec3& tip) {
+		if (i >= m_prims.size()) {
+			return;
+		}
+		m_prims[m_slotOf[i]].tip = tip;
+		++m_refits;
+		uint32_t node = m_leafOf[m_slotOf[i]];
+		while (true) {
+			Node& n = m_nodes[node];
+			glm::vec3 oldMin = n.min;
+			glm::vec3 oldMax = n.max;
+			if (n.count > 0) {
+				Bounds box = bounds(n.first, n.first + n.count);
+				n.min = box.min;
+				n.max = box.max;
+			}
+			else {
+				n.min = glm::min(m_nodes[n.first].min, m_nodes[n.first + 1].min);
+				n.max = glm::max(m_nodes[n.first].max, m_nodes[n.first + 1].max);
+			}
+			//nothing changed here, nothing changes further up
+			if (node == 0 || (n.min == oldMin && n.max == oldMax)) {
+				break;
+			}
+			node = m_parents[node];
+		}
+	};
+
+	//after many refits siblings overlap more and more, a fresh build is cheaper than slow queries
+	bool needsRebuild() const { return m_refits > m_prims.size() / 4 + 64; }
+
+	size_t size() const { return m_prims.size(); }
+	bool empty() const { return m_prims.empty(); }
+	size_t nodeCount() const { return m_nodes.size(); }
+
+
+	//closest arrow along the ray that passes within radius of it, NOT_FOUND if none does
+	//hitDistance (if given) gets the ray parameter of the closest approach
+	size_t raycast(const glm::vec3& from, const glm::vec3& direction, float radius, float* hitDistance = nullptr) const {
+		if (m_nodes.empty()) {
+			return NOT_FOUND;
+		}
+		glm::vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+		float bestT = std::numeric_limits<float>::infinity();
+		size_t best = NOT_FOUND;
+		float radius2 = radius * radius;
+		float entry;
+
+		uint32_t stack[MAX_DEPTH + 2];
+		int top = 0;
+		if (rayHitsArrows(m_nodes[0], from, inverse, radius, bestT, entry)) {
+			stack[top++] = 0;
+		}
+		while (top > 0) {
+			const Node& node = m_nodes[stack[--top]];
+			if (node.count > 0) {
+				for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+					float t;
+					if (raySegmentDistance2(from, direction, m_prims[k].tip, t) <= radius2 && t < bestT) {
+						bestT = t;
+						best = m_prims[k].index;
+					}
+				}
+				continue;
+			}
+			//nearer child on top, so it's searched first and bestT prunes the other one
+			float leftEntry, rightEntry;
+			bool hitLeft = rayHitsArrows(m_nodes[node.first], from, inverse, radius, bestT, leftEntry);
+			bool hitRight = rayHitsArrows(m_nodes[node.first + 1], from, inverse, radius, bestT, rightEntry);
+			if (hitLeft && hitRight) {
+				bool leftFirst = leftEntry <= rightEntry;
+				stack[top++] = leftFirst ? node.first + 1 : node.first;
+				stack[top++] = leftFirst ? node.first : node.first + 1;
+			}
+			else if (hitLeft || hitRight) {
+				stack[top++] = hitLeft ? node.first : node.first + 1;
+			}
+		}
+		if (hitDistance != nullptr && best != NOT_FOUND) {
+			*hitDistance = bestT;
+		}
+		return best;
+	};
+
+	//every vector whose tip lies inside [min, max], appended to out (unordered)
+	void queryBox(const glm::vec3& min, const glm::vec3& max, std::vector<size_t>& out) const {
+		if (m_nodes.empty()) {
+			return;
+		}
+		uint32_t stack[MAX_DEPTH + 2];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const Node& node = m_nodes[stack[--top]];
+			if (glm::any(glm::greaterThan(node.min, max)) || glm::any(glm::lessThan(node.max, min))) {
+				continue;
+			}
+			//the whole subtree is inside, its primitives are one range
+			if (glm::all(glm::greaterThanEqual(node.min, min)) && glm::all(glm::lessThanEqual(node.max, max))) {
+				uint32_t first, last;
+				primitiveRange(node, first, last);
+				for (uint32_t k = first; k < last; ++k) {
+					out.push_back(m_prims[k].index);
+				}
+				continue;
+			}
+			if (node.count > 0) {
+				for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+					const glm::vec3& tip = m_prims[k].tip;
+					if (glm::all(glm::greaterThanEqual(tip, min)) && glm::all(glm::lessThanEqual(tip, max))) {
+						out.push_back(m_prims[k].index);
+					}
+				}
+				continue;
+			}
+			stack[top++] = node.first;
+			stack[top++] = node.first + 1;
+		}
+	};
+
+	//the arrow closest to point (no further than maxDistance), NOT_FOUND if there's none
+	size_t nearest(const glm::vec3& point, float maxDistance = std::numeric_limits<float>::infinity(), float* distance = nullptr) const {
+		if (m_nodes.empty()) {
+			return NOT_FOUND;
+		}
+		float best2 = maxDistance * maxDistance;
+		size_t best = NOT_FOUND;
+
+		uint32_t stack[MAX_DEPTH + 2];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const Node& node = m_nodes[stack[--top]];
+			if (arrowsDistance2(node, point) > best2) {
+				continue;
+			}
+			if (node.count > 0) {
+				for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+					float d2 = pointSegmentDistance2(point, m_prims[k].tip);
+					if (d2 <= best2) {
+						best2 = d2;
+						best = m_prims[k].index;
+					}
+				}
+				continue;
+			}
+			uint32_t closer = node.first;
+			uint32_t further = node.first + 1;
+			if (arrowsDistance2(m_nodes[further], point) < arrowsDistance2(m_nodes[closer], point)) {
+				std::swap(closer, further);
+			}
+			stack[top++] = further;
+			stack[top++] = closer;
+		}
+		if (distance != nullptr && best != NOT_FOUND) {
+			*distance = std::sqrt(best2);
+		}
+		return best;
+	};
+
+
+	// ============ the same tests, one primitive at a time (also what the benchmark compares against) ============
+
+	//squared distance between the ray from + t * direction (t >= 0) and the segment 0 -> tip, t of the closest point
+	static float raySegmentDistance2(const glm::vec3& from, const glm::vec3& direction, const glm::vec3& tip, float& t) {
+		const float eps = 1e-12f;
+		float a = glm::dot(direction, direction);
+		float e = glm::dot(tip, tip);
+		float b = glm::dot(direction, tip);
+		float c = glm::dot(direction, from);
+		float f = glm::dot(tip, from);
+		float s = 0.0f; //along the segment, 0..1
+		t = 0.0f;
+		if (e <= eps) {
+			t = std::max(-c / a, 0.0f);
+		}
+		else {
+			float denominator = a * e - b * b;
+			t = denominator > eps ? std::max((b * f - c * e) / denominator, 0.0f) : 0.0f;
+			s = (b * t + f) / e;
+			if (s < 0.0f) {
+				s = 0.0f;
+				t = std::max(-c / a, 0.0f);
+			}
+			else if (s > 1.0f) {
+				s = 1.0f;
+				t = std::max((b - c) / a, 0.0f);
+			}
+		}
+		glm::vec3 gap = from + direction * t - tip * s;
+		return glm::dot(gap, gap);
+	};
+
+	static float pointSegmentDistance2(const glm::vec3& point, const glm::vec3& tip) {
+		float length2 = glm::dot(tip, tip);
+		float s = length2 > 0.0f ? std::clamp(glm::dot(point, tip) / length2, 0.0f, 1.0f) : 0.0f;
+		glm::vec3 gap = point - tip * s;
+		return glm::dot(gap, gap);
+	};
+
+
+
+private:
+	struct Prim {
+		glm::vec3 tip;
+		uint32_t index; //the vector's dense index
+	};
+
+	std::vector<Node> m_nodes;
+	std::vector<uint32_t> m_parents;
+	std::vector<Prim> m_prims; //in tree order, every leaf owns a range
+	std::vector<uint32_t> m_slotOf; //by vector index: where it is in m_prims
+	std::vector<uint32_t> m_leafOf; //by position in m_prims (written in order, unlike m_slotOf)
+	std::atomic<uint32_t> m_nodeCount{ 0 };
+	size_t m_refits = 0;
+	TaskPool* m_pool = nullptr; //only during build()
+
+	struct Bounds {
+		glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+		//per component, this is the innermost loop of the build
+		void grow(const glm::vec3& p) {
+			min.x = std::min(min.x, p.x);
+			min.y = std::min(min.y, p.y);
+			min.z = std::min(min.z, p.z);
+			max.x = std::max(max.x, p.x);
+			max.y = std::max(max.y, p.y);
+			max.z = std::max(max.z, p.z);
+		}
+		void grow(const Bounds& other) {
+			min.x = std::min(min.x, other.min.x);
+			min.y = std::min(min.y, other.min.y);
+			min.z = std::min(min.z, other.min.z);
+			max.x = std::max(max.x, other.max.x);
+			max.y = std::max(max.y, other.max.y);
+			max.z = std::max(max.z, other.max.z);
+		}
+
+		//surface area (halved) of the arrows' box: the tips' box stretched to take in the origin
+		float arrowArea() const {
+			float dx = std::max(max.x, 0.0f) - std::min(min.x, 0.0f);
+			float dy = std::max(max.y, 0.0f) - std::min(min.y, 0.0f);
+			float dz = std::max(max.z, 0.0f) - std::min(min.z, 0.0f);
+			return dx * dy + dy * dz + dz * dx;
+		}
+	};
+
+	struct Bin {
+		Bounds box;
+		uint32_t count = 0;
+	};
+	typedef Bin Bins[3][BINS];
+
+
+	//body(begin, end) over [begin, end), on the pool when the range is big enough
+	template<typename Body>
+	void forRange(uint32_t begin, uint32_t end, Body body) {
+		if (m_pool != nullptr && end - begin >= PARALLEL_MIN) {
+			m_pool->parallelFor(end - begin, PARALLEL_MIN / 2, [&](size_t b, size_t e) { body(begin + (uint32_t)b, begin + (uint32_t)e); });
+		}
+		else {
+			body(begin, end);
+		}
+	};
+
+	//the tips' box of a range of primitives
+	Bounds bounds(uint32_t begin, uint32_t end) const {
+		Bounds box;
+		for (uint32_t k = begin; k < end; ++k) {
+			box.grow(m_prims[k].tip);
+		}
+		return box;
+	};
+
+	//box is the tips' box of [begin, end), the parent already has it from its bins
+	void buildNode(uint32_t index, uint32_t begin, uint32_t end, int depth, const Bounds& box) {
+		uint32_t count = end - begin;
+		Node& node = m_nodes[index];
+		node.min = box.min;
+		node.max = box.max;
+		if (count <= 2 || depth >= MAX_DEPTH) {
+			makeLeaf(index, begin, count);
+			return;
+		}
+
+		//bins along every axis (binning the tips is binning the centroids, they're tip / 2)
+		glm::vec3 extent = box.max - box.min;
+		glm::vec3 scale(0.0f);
+		for (int axis = 0; axis < 3; ++axis) {
+			scale[axis] = extent[axis] > 0.0f ? BINS / extent[axis] : 0.0f;
+		}
+		Bins bins;
+		fillBins(begin, end, box.min, scale, bins);
+
+		//sweep the bins from both sides, cost = count * area on either side
+		int bestAxis = -1;
+		int bestSplit = 0;
+		float bestCost = std::numeric_limits<float>::max();
+		Bounds bestLeft, bestRight;
+		for (int axis = 0; axis < 3; ++axis) {
+			if (extent[axis] <= 0.0f) {
+				continue;
+			}
+			Bounds rightBox[BINS];
+			uint32_t rightCount[BINS];
+			Bounds right;
+			uint32_t rightSum = 0;
+			for (int b = BINS - 1; b > 0; --b) {
+				right.grow(bins[axis][b].box);
+				rightSum += bins[axis][b].count;
+				rightBox[b] = right;
+				rightCount[b] = rightSum;
+			}
+			Bounds left;
+			uint32_t leftSum = 0;
+			for (int b = 1; b < BINS; ++b) {
+				left.grow(bins[axis][b - 1].box);
+				leftSum += bins[axis][b - 1].count;
+				if (leftSum == 0 || rightCount[b] == 0) {
+					continue;
+				}
+				float cost = leftSum * left.arrowArea() + rightCount[b] * rightBox[b].arrowArea();
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b;
+					bestLeft = left;
+					bestRight = rightBox[b];
+				}
+			}
+		}
+
+		//traversal counts as one primitive test
+		float area = box.arrowArea();
+		float splitCost = 1.0f + (area > 0.0f ? bestCost / area : (float)count);
+		if (count <= MAX_LEAF && (bestAxis < 0 || splitCost >= (float)count)) {
+			makeLeaf(index, begin, count);
+			return;
+		}
+
+		uint32_t split;
+		if (bestAxis < 0) {
+			//every tip in the same spot, any split is as good as another
+			split = begin + count / 2;
+			bestLeft = bounds(begin, split);
+			bestRight = bounds(split, end);
+		}
+		else {
+			float low = box.min[bestAxis];
+			float axisScale = scale[bestAxis];
+			Prim* middle = std::partition(m_prims.data() + begin, m_prims.data() + end, [&](const Prim& prim) {
+				return binOf(prim.tip[bestAxis], low, axisScale) < bestSplit;
+			});
+			split = (uint32_t)(middle - m_prims.data());
+		}
+
+		uint32_t children = m_nodeCount.fetch_add(2);
+		node.first = children;
+		node.count = 0;
+		m_parents[children] = index;
+		m_parents[children + 1] = index;
+
+		if (m_pool != nullptr && count >= PARALLEL_MIN) {
+			m_pool->parallelFor(2, 1, [&](size_t child, size_t) {
+				if (child == 0) {
+					buildNode(children, begin, split, depth + 1, bestLeft);
+				}
+				else {
+					buildNode(children + 1, split, end, depth + 1, bestRight);
+				}
+			});
+		}
+		else {
+			buildNode(children, begin, split, depth + 1, bestLeft);
+			buildNode(children + 1, split, end, depth + 1, bestRight);
+		}
+	};
+
+	//big ranges are binned in chunks on the pool, the partial bins merged afterwards
+	void fillBins(uint32_t begin, uint32_t end, const glm::vec3& low, const glm::vec3& scale, Bins& bins) {
+		auto fill = [&](uint32_t b, uint32_t e, Bins& out) {
+			//copies, so the compiler knows the bins being written don't change them
+			const glm::vec3 origin = low;
+			const glm::vec3 factor = scale;
+			const Prim* prims = m_prims.data();
+			for (uint32_t k = b; k < e; ++k) {
+				const glm::vec3 tip = prims[k].tip;
+				for (int axis = 0; axis < 3; ++axis) {
+					Bin& bin = out[axis][binOf(tip[axis], origin[axis], factor[axis])];
+					bin.box.grow(tip);
+					++bin.count;
+				}
+			}
+		};
+		if (m_pool == nullptr || end - begin < PARALLEL_MIN) {
+			fill(begin, end, bins);
+			return;
+		}
+		uint32_t grain = PARALLEL_MIN / 2;
+		std::vector<Bins> partials((end - begin + grain - 1) / grain);
+		m_pool->parallelFor(end - begin, grain, [&](size_t b, size_t e) {
+			fill(begin + (uint32_t)b, begin + (uint32_t)e, partials[b / grain]);
+		});
+		for (const Bins& partial : partials) {
+			for (int axis = 0; axis < 3; ++axis) {
+				for (int b = 0; b < BINS; ++b) {
+					bins[axis][b].box.grow(partial[axis][b].box);
+					bins[axis][b].count += partial[axis][b].count;
+				}
+			}
+		}
+	};
+
+	void makeLeaf(uint32_t index, uint32_t begin, uint32_t count) {
+		Node& node = m_nodes[index];
+		node.first = begin;
+		node.count = count;
+		for (uint32_t k = begin; k < begin + count; ++k) {
+			m_slotOf[m_prims[k].index] = k;
+			m_leafOf[k] = index;
+		}
+	};
+
+	//a subtree owns one contiguous range: from its leftmost leaf's first to its rightmost leaf's last
+	void primitiveRange(const Node& node, uint32_t& first, uint32_t& last) const {
+		const Node* left = &node;
+		while (left->count == 0) {
+			left = &m_nodes[left->first];
+		}
+		const Node* right = &node;
+		while (right->count == 0) {
+			right = &m_nodes[right->first + 1];
+		}
+		first = left->first;
+		last = right->first + right->count;
+	};
+
+
+	//clamped before the cast: a NaN (an inf tip makes inf * 0) fails both tests and goes into bin 0
+	static int binOf(float value, float low, float scale) {
+		float bin = (value - low) * scale;
+		if (!(bin > 0.0f)) {
+			return 0;
+		}
+		return bin < (float)(BINS - 1) ? (int)bin : BINS - 1;
+	};
+
+	//slab test against the node's arrows, entry gets where the ray comes in (0 if it starts inside)
+	static bool rayHitsArrows(const Node& node, const glm::vec3& from, const glm::vec3& inverse, float radius, float maxT, float& entry) {
+		glm::vec3 min = glm::min(node.min, glm::vec3(0.0f)) - radius;
+		glm::vec3 max = glm::max(node.max, glm::vec3(0.0f)) + radius;
+		glm::vec3 t0 = (min - from) * inverse;
+		glm::vec3 t1 = (max - from) * inverse;
+		glm::vec3 enter = glm::min(t0, t1);
+		glm::vec3 leave = glm::max(t0, t1);
+		entry = std::max(std::max(enter.x, enter.y), std::max(enter.z, 0.0f));
+		float exit = std::min(std::min(leave.x, leave.y), leave.z);
+		return entry <= exit && entry <= maxT;
+	};
+
+	static float arrowsDistance2(const Node& node, const glm::vec3& point) {
+		glm::vec3 min = glm::min(node.min, glm::vec3(0.0f));
+		glm::vec3 max = glm::max(node.max, glm::vec3(0.0f));
+		glm::vec3 gap = glm::max(glm::max(min - point, point - max), glm::vec3(0.0f));
+		return glm::dot(gap, gap);
+	};
+};
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include "vectorStore.h"
+
+// What happened to a VectorStore's dense arrays during one update tick, for a copy on another thread.
+// Every dense entry that was written (added, edited, or filled by the last one on a removal) gets a write, in
+// order; size is the count at the end of the tick. Resizing a copy to size and replaying the writes below it
+// leaves it equal to the store, whatever mix of adds, edits, removals and clears happened in between.
+// Whole appended blocks (loads, import chunks) are kept as blocks, same arrays, so they replay as a few copies
+// instead of one write per vector. A clear is only the size.
+struct VectorDelta {
+	//dense entries [first, first + handles.size()) as the store had them, replayed after the first writesBefore writes
+	struct Block {
+		size_t first = 0;
+		size_t writesBefore = 0;
+		std::vector<VectorHandle> handles;
+		VectorArrays values;
+		std::vector<glm::vec3> colors;
+
+		size_t count() const { return handles.size(); }
+	};
+
+	uint64_t sequence = 0; //1, 2, 3, ... in the order the ticks happened
+	size_t size = 0;
+	std::vector<uint32_t> index;
+	std::vector<VectorHandle> handles;
+	VectorArrays values;
+	std::vector<glm::vec3> colors;
+	std::vector<Block> blocks;
+
+	//the store's dense entry i, as it is now
+	void write(const VectorStore& vectors, size_t i) {
+		index.push_back((uint32_t)i);
+		handles.push_back(vectors.handle(i));
+		values.push_back(vectors.valueAt(i));
+		colors.push_back(vectors.colorAt(i));
+	};
+
+	//the store's dense entries [first, first + count), as they are now
+	void writeBlock(const VectorStore& vectors, size_t first, size_t count) {
+		Block block;
+		block.first = first;
+		block.writesBefore = index.size();
+		block.handles.resize(count);
+		for (size_t i = 0; i < count; ++i) {
+			block.handles[i] = vectors.handle(first + i);
+		}
+		const VectorArrays& source = vectors.values();
+		block.values.append(source.x.data() + first, source.y.data() + first, source.z.data() + first, count);
+		block.colors.assign(vectors.colors().begin() + first, vectors.colors().begin() + first + count);
+		blocks.push_back(std::move(block));
+	};
+
+	size_t writes() const { return index.size(); }
+
+	//what a replay counts through: every write and every block entry is one
+	size_t entries() const {
+		size_t count = writes();
+		for (const Block& block : blocks) {
+			count += block.count();
+		}
+		return count;
+	};
+};
+
+
+// Read-only copy of a VectorStore on the render thread, kept equal to it by VectorDeltas: the dense arrays
+// with the handle of every entry, so picks and list rows still turn into handles for the commands that go back.
+class VectorMirror {
+public:
+	static constexpr size_t NOT_FOUND = VectorStore::NOT_FOUND;
+
+	void apply(const VectorDelta& delta) {
+		apply(delta, 0, delta.entries(), [](size_t, size_t) {});
+	};
+
+	//replays the delta's entries [from, from + budget) in order and returns where it got to, delta.entries() once
+	//it is through. A big delta (a load) can be spread over several calls like this, the copy just isn't equal to
+	//the store in between. written(first, count) gets every dense range that changed
+	//The copy shrinks right away but only grows as the new entries come in (into reserved memory, so a big load
+	//neither moves nor zero-fills everything in its first piece)
+	template <typename F>
+	size_t apply(const VectorDelta& delta, size_t from, size_t budget, F written) {
+		if (from == 0) {
+			if (delta.size < size()) {
+				resize(delta.size);
+			}
+			else {
+				m_handles.reserve(delta.size);
+				m_values.reserve(delta.size);
+				m_colors.reserve(delta.size);
+			}
+		}
+		size_t end = from + std::min(budget, delta.entries() - from);
+
+		//at = position of the next entry, w = next write
+		size_t at = 0;
+		size_t w = 0;
+		auto replayWrites = [&](size_t until) {
+			size_t begin = std::max(at, from);
+			size_t stop = std::min(at + (until - w), end);
+			for (size_t p = begin; p < stop; ++p) {
+				size_t i = applyWrite(delta, w + (p - at));
+				if (i != NOT_FOUND) {
+					written(i, 1);
+				}
+			}
+			at += until - w;
+			w = until;
+		};
+		for (const VectorDelta::Block& block : delta.blocks) {
+			replayWrites(block.writesBefore);
+			size_t begin = std::max(at, from);
+			size_t stop = std::min(at + block.count(), end);
+			if (begin < stop) {
+				size_t first = block.first + (begin - at);
+				size_t count = applyBlock(block, begin - at, stop - begin, delta.size);
+				if (count > 0) {
+					written(first, count);
+				}
+			}
+			at += block.count();
+		}
+		replayWrites(delta.writes());
+		if (end == delta.entries()) {
+			resize(delta.size);
+		}
+		return end;
+	};
+
+
+	size_t size() const { return m_handles.size(); }
+	bool empty() const { return m_handles.empty(); }
+	VectorHandle handle(size_t dense) const { return m_handles[dense]; }
+	glm::vec3 valueAt(size_t dense) const { return m_values.get(dense); }
+	glm::vec3 colorAt(size_t dense) const { return m_colors[dense]; }
+
+	//stale slots may still point somewhere, the handle stored there tells
+	size_t denseIndex(VectorHandle handle) const {
+		if (handle.index >= m_denseOf.size()) {
+			return NOT_FOUND;
+		}
+		size_t dense = m_denseOf[handle.index];
+		return dense < m_handles.size() && m_handles[dense] == handle ? dense : NOT_FOUND;
+	};
+
+	bool valid(VectorHandle handle) const { return denseIndex(handle) != NOT_FOUND; }
+
+
+
+private:
+	std::vector<VectorHandle> m_handles;
+	VectorArrays m_values;
+	std::vector<glm::vec3> m_colors;
+	std::vector<uint32_t> m_denseOf; //slot -> dense, as last written
+
+
+	void resize(size_t count) {
+		m_handles.resize(count);
+		m_values.resize(count);
+		m_colors.resize(count);
+	};
+
+	//returns the dense index written, NOT_FOUND if it was added and gone again in the same tick
+	size_t applyWrite(const VectorDelta& delta, size_t w) {
+		size_t i = delta.index[w];
+		if (i >= delta.size) {
+			return NOT_FOUND;
+		}
+		if (i >= size()) {
+			resize(i + 1);
+		}
+		m_handles[i] = delta.handles[w];
+		m_values.set(i, delta.values.get(w));
+		m_colors[i] = delta.colors[w];
+		point(delta.handles[w], i);
+		return i;
+	};
+
+	//block entries [offset, offset + count), a copy per array. Only what is still inside the final size (the tail
+	//may have been removed later in the tick), returns how many that were
+	size_t applyBlock(const VectorDelta::Block& block, size_t offset, size_t count, size_t finalSize) {
+		size_t first = block.first + offset;
+		if (first >= finalSize) {
+			return 0;
+		}
+		count = std::min(count, finalSize - first);
+		if (first + count > size()) {
+			resize(first + count);
+		}
+		std::copy(block.handles.begin() + offset, block.handles.begin() + offset + count, m_handles.begin() + first);
+		std::copy(block.values.x.begin() + offset, block.values.x.begin() + offset + count, m_values.x.begin() + first);
+		std::copy(block.values.y.begin() + offset, block.values.y.begin() + offset + count, m_values.y.begin() + first);
+		std::copy(block.values.z.begin() + offset, block.values.z.begin() + offset + count, m_values.z.begin() + first);
+		std::copy(block.colors.begin() + offset, block.colors.begin() + offset + count, m_colors.begin() + first);
+		for (size_t i = 0; i < count; ++i) {
+			point(block.handles[offset + i], first + i);
+		}
+		return count;
+	};
+
+	void point(VectorHandle handle, size_t dense) {
+		if (handle.index >= m_denseOf.size()) {
+			m_denseOf.resize(handle.index + 1, 0);
+		}
+		m_denseOf[handle.index] = (uint32_t)dense;
+	};
+};
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "vectorKernels.h"
+
+// Read-only view of a whole file through the OS page cache (mmap / MapViewOfFile), nothing is copied
+// until the pages are touched. Empty or missing files give data() == nullptr.
+class MappedFile {
+public:
+	MappedFile() {};
+
+	explicit MappedFile(const std::string& path) {
+		open(path);
+	};
+
+	~MappedFile() {
+		close();
+	};
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+
+	bool open(const std::string& path) {
+		close();
+#ifdef _WIN32
+		m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (m_file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) {
+			close();
+			return false;
+		}
+		m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (m_mapping == NULL) {
+			close();
+			return false;
+		}
+		m_data = (const uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+		m_size = (size_t)size.QuadPart;
+#else
+		m_file = ::open(path.c_str(), O_RDONLY);
+		if (m_file < 0) {
+			return false;
+		}
+		struct stat info;
+		if (fstat(m_file, &info) != 0 || info.st_size == 0) {
+			close();
+			return false;
+		}
+		void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+		if (data == MAP_FAILED) {
+			close();
+			return false;
+		}
+		//read front to back once, let the kernel read ahead
+		madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+		m_data = (const uint8_t*)data;
+		m_size = (size_t)info.st_size;
+#endif
+		if (m_data == nullptr) {
+			close();
+			return false;
+		}
+		return true;
+	};
+
+	void close() {
+#ifdef _WIN32
+		if (m_data != nullptr) {
+			UnmapViewOfFile(m_data);
+		}
+		if (m_mapping != NULL) {
+			CloseHandle(m_mapping);
+		}
+		if (m_file != INVALID_HANDLE_VALUE) {
+			CloseHandle(m_file);
+		}
+		m_mapping = NULL;
+		m_file = INVALID_HANDLE_VALUE;
+#else
+		if (m_data != nullptr) {
+			munmap((void*)m_data, m_size);
+		}
+		if (m_file >= 0) {
+			::close(m_file);
+		}
+		m_file = -1;
+#endif
+		m_data = nullptr;
+		m_size = 0;
+	};
+
+	const uint8_t* data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+
+
+private:
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	HANDLE m_file = INVALID_HANDLE_VALUE;
+	HANDLE m_mapping = NULL;
+#else
+	int m_file = -1;
+#endif
+};
+
+
+// .pvec vector sets, little endian:
+//   VectorFileHeader (32 bytes)
+//   float x[count], float y[count], float z[count]   the same SoA layout as VectorArrays
+//   uint32_t colors[count]                            packed RGBA8 like ArrowInstance::color, if HAS_COLORS
+// Every array starts 4 byte aligned, so a mapped file is used in place: no parsing, one copy per array.
+struct VectorFileHeader {
+	char magic[4] = { 'P', 'V', 'E', 'C' };
+	uint32_t version = 1;
+	uint64_t count = 0;
+	uint32_t flags = 0;
+	uint32_t headerSize = sizeof(VectorFileHeader); //arrays start here, room to grow the header later
+	uint64_t reserved = 0;
+
+	static constexpr uint32_t HAS_COLORS = 1;
+};
+static_assert(sizeof(VectorFileHeader) == 32, "the header is part of the file format");
+
+
+// A mapped .pvec file. The arrays point into the mapping and live as long as this does.
+class VectorFile {
+public:
+	bool open(const std::string& path) {
+		m_count = 0;
+		if (!m_file.open(path)) {
+			std::cout << "ERROR::VECTOR_FILE::NOT_READ " << path << "\n";
+			return false;
+		}
+		if (m_file.size() < sizeof(VectorFileHeader)) {
+			std::cout << "ERROR::VECTOR_FILE::TOO_SHORT " << path << "\n";
+			return false;
+		}
+		VectorFileHeader header;
+		std::memcpy(&header, m_file.data(), sizeof(header));
+		if (std::memcmp(header.magic, "PVEC", 4) != 0 || header.version != 1 || header.headerSize < sizeof(VectorFileHeader) || header.headerSize % 4 != 0) {
+			std::cout << "ERROR::VECTOR_FILE::BAD_HEADER " << path << "\n";
+			return false;
+		}
+		bool colors = (header.flags & VectorFileHeader::HAS_COLORS) != 0;
+		//divided instead of multiplied, a huge count must not wrap around into a small size
+		uint64_t bytesPerVector = 3 * sizeof(float) + (colors ? sizeof(uint32_t) : 0);
+		if (header.headerSize > m_file.size() || header.count > (m_file.size() - header.headerSize) / bytesPerVector) {
+			std::cout << "ERROR::VECTOR_FILE::TRUNCATED " << path << "\n";
+			return false;
+		}
+
+		m_count = (size_t)header.count;
+		const uint8_t* arrays = m_file.data() + header.headerSize;
+		m_x = (const float*)arrays;
+		m_y = m_x + m_count;
+		m_z = m_y + m_count;
+		m_colors = colors ? (const uint32_t*)(m_z + m_count) : nullptr;
+		return true;
+	};
+
+	size_t size() const { return m_count; }
+	const float* x() const { return m_x; }
+	const float* y() const { return m_y; }
+	const float* z() const { return m_z; }
+	const uint32_t* colors() const { return m_colors; } //nullptr if the file has none
+
+
+
+private:
+	MappedFile m_file;
+	size_t m_count = 0;
+	const float* m_x = nullptr;
+	const float* m_y = nullptr;
+	const float* m_z = nullptr;
+	const uint32_t* m_colors = nullptr;
+};
+
+
+//writes values (+ packed colors, if given one per vector) as a .pvec file
+inline bool saveVectorFile(const std::string& path, const VectorArrays& values, const std::vector<uint32_t>* colors) {
+	FILE* file = std::fopen(path.c_str(), "wb");
+	if (file == nullptr) {
+		std::cout << "ERROR::VECTOR_FILE::NOT_WRITTEN " << path << "\n";
+		return false;
+	}
+	VectorFileHeader header;
+	header.count = values.size();
+	bool hasColors = colors != nullptr && colors->size() == values.size();
+	header.flags = hasColors ? VectorFileHeader::HAS_COLORS : 0;
+
+	size_t n = values.size();
+	bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && std::fwrite(values.x.data(), sizeof(float), n, file) == n;
+	ok = ok && std::fwrite(values.y.data(), sizeof(float), n, file) == n;
+	ok = ok && std::fwrite(values.z.data(), sizeof(float), n, file) == n;
+	if (hasColors) {
+		ok = ok && std::fwrite(colors->data(), sizeof(uint32_t), n, file) == n;
+	}
+	ok = std::fclose(file) == 0 && ok;
+	if (!ok) {
+		std::cout << "ERROR::VECTOR_FILE::NOT_WRITTEN " << path << "\n";
+	}
+	return ok;
+}
+
+inline bool isVectorFile(const std::string& path) {
+	return path.size() >= 5 && path.compare(path.size() - 5, 5, ".pvec") == 0;
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <charconv>
+#include <iostream>
+
+#include "vectorKernels.h"
+#include "vectorFile.h"
+
+//one "x y z" or "x y z r g b" line, numbers separated by spaces, tabs, commas or semicolons.
+//Moves p to the start of the next line; false for blank lines, '#' comments and anything that isn't
+//at least three numbers (CSV header rows).
+inline bool parseVectorLine(const char*& p, const char* end, glm::vec3& point, glm::vec3& color, bool& hasColor) {
+	auto separator = [](char c) { return c == ' ' || c == '\t' || c == ',' || c == ';' || c == '\r'; };
+	const char* lineEnd = p;
+	while (lineEnd < end && *lineEnd != '\n') {
+		++lineEnd;
+	}
+	const char* next = lineEnd < end ? lineEnd + 1 : end;
+
+	float values[6];
+	int count = 0;
+	const char* c = p;
+	while (count < 6) {
+		while (c < lineEnd && separator(*c)) {
+			++c;
+		}
+		if (c >= lineEnd || *c == '#') {
+			break;
+		}
+		if (*c == '+') {
+			++c; //from_chars doesn't take a leading plus
+		}
+		std::from_chars_result result = std::from_chars(c, lineEnd, values[count]);
+		if (result.ec != std::errc()) {
+			break;
+		}
+		c = result.ptr;
+		++count;
+	}
+	p = next;
+	if (count < 3) {
+		return false;
+	}
+	point = glm::vec3(values[0], values[1], values[2]);
+	hasColor = count == 6;
+	if (hasColor) {
+		color = glm::vec3(values[3], values[4], values[5]);
+	}
+	return true;
+}
+
+
+// Text / CSV import on a background thread.
+// The file is mapped (see vectorFile.h) and parsed with std::from_chars, no streams and no locale. Parsed
+// vectors are handed over in chunks: the update thread poll()s a few of them per tick and appends them to the
+// store, so a file with millions of lines fills in over a couple of frames instead of freezing one.
+// At most MAX_QUEUED chunks wait at a time, the parser sleeps until the update thread catches up.
+class VectorImporter {
+public:
+	struct Chunk {
+		VectorArrays values;
+		std::vector<glm::vec3> colors;
+	};
+
+	static constexpr size_t CHUNK_SIZE = 1 << 16; //vectors
+	static constexpr size_t MAX_QUEUED = 16;
+
+	~VectorImporter() {
+		cancel();
+	};
+
+
+	//false if an import is still running or the file can't be opened
+	bool start(const std::string& path, const glm::vec3& defaultColor) {
+		if (m_running) {
+			return false;
+		}
+		join();
+		auto file = std::make_shared<MappedFile>();
+		if (!file->open(path)) {
+			std::cout << "ERROR::IMPORT::NOT_READ " << path << "\n";
+			return false;
+		}
+		m_cancel = false;
+		m_done = false;
+		m_bytesParsed = 0;
+		m_bytesTotal = file->size();
+		m_parsed = 0;
+		m_running = true;
+		m_thread = std::thread(&VectorImporter::run, this, file, defaultColor);
+		return true;
+	};
+
+	//update thread: moves up to maxChunks finished chunks into out, in file order
+	size_t poll(std::vector<Chunk>& out, size_t maxChunks = 4) {
+		size_t taken = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			while (taken < maxChunks && !m_chunks.empty()) {
+				out.push_back(std::move(m_chunks.front()));
+				m_chunks.pop_front();
+				++taken;
+			}
+		}
+		if (taken > 0) {
+			m_space.notify_one();
+		}
+		if (m_done && !m_running) {
+			join();
+		}
+		return taken;
+	};
+
+	//stops the parser, whatever wasn't polled yet is dropped
+	void cancel() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_cancel = true;
+		}
+		m_space.notify_one();
+		join();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_chunks.clear();
+	};
+
+	//true until the last chunk has been polled
+	bool busy() const {
+		if (m_running) {
+			return true;
+		}
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return !m_chunks.empty();
+	}
+
+	float progress() const { return m_bytesTotal == 0 ? 1.0f : (float)m_bytesParsed / (float)m_bytesTotal; }
+	size_t parsed() const { return m_parsed; }
+
+
+
+private:
+	std::thread m_thread;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_space;
+	std::deque<Chunk> m_chunks;
+
+	std::atomic<bool> m_running{ false };
+	std::atomic<bool> m_done{ false };
+	std::atomic<bool> m_cancel{ false };
+	std::atomic<size_t> m_bytesParsed{ 0 };
+	std::atomic<size_t> m_parsed{ 0 };
+	size_t m_bytesTotal = 0;
+
+
+	void join() {
+		if (m_thread.joinable()) {
+			m_thread.join();
+		}
+	};
+
+	void run(std::shared_ptr<MappedFile> file, glm::vec3 defaultColor) {
+		const char* begin = (const char*)file->data();
+		const char* end = begin + file->size();
+		const char* p = begin;
+
+		Chunk chunk;
+		chunk.values.reserve(CHUNK_SIZE);
+		chunk.colors.reserve(CHUNK_SIZE);
+		while (p < end && !m_cancel) {
+			glm::vec3 point;
+			glm::vec3 color = defaultColor;
+			bool hasColor = false;
+			if (parseVectorLine(p, end, point, color, hasColor)) {
+				chunk.values.push_back(point);
+				chunk.colors.push_back(hasColor ? color : defaultColor);
+			}
+			if (chunk.values.size() == CHUNK_SIZE) {
+				m_bytesParsed = (size_t)(p - begin);
+				publish(chunk);
+				chunk.values.reserve(CHUNK_SIZE);
+				chunk.colors.reserve(CHUNK_SIZE);
+			}
+		}
+		if (!chunk.values.empty() && !m_cancel) {
+			publish(chunk);
+		}
+		m_bytesParsed = m_bytesTotal;
+		m_done = true;
+		m_running = false;
+	};
+
+	//waits for room in the queue, then moves the chunk in (leaves it empty)
+	void publish(Chunk& chunk) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_space.wait(lock, [this] { return m_chunks.size() < MAX_QUEUED || m_cancel; });
+		if (m_cancel) {
+			return;
+		}
+		m_parsed += chunk.values.size();
+		m_chunks.push_back(std::move(chunk));
+		chunk = Chunk();
+	};
+};
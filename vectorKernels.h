@@ -0,0 +1,574 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VECTOR_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+//gcc/clang only emit AVX2 for functions that ask for it, msvc takes intrinsics anywhere
+#if defined(VECTOR_KERNELS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define KERNEL_SSE __attribute__((target("sse2")))
+#define KERNEL_AVX2 __attribute__((target("avx2")))
+#else
+#define KERNEL_SSE
+#define KERNEL_AVX2
+#endif
+
+
+// Vectors stored structure-of-arrays: all x, then all y, then all z, so the kernels below
+// load 4 (SSE) or 8 (AVX2) vectors per instruction instead of walking vec3s one by one.
+struct VectorArrays {
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+
+	size_t size() const { return x.size(); }
+	bool empty() const { return x.empty(); }
+
+	void resize(size_t count) {
+		x.resize(count);
+		y.resize(count);
+		z.resize(count);
+	}
+
+	void reserve(size_t count) {
+		x.reserve(count);
+		y.reserve(count);
+		z.reserve(count);
+	}
+
+	void clear() {
+		x.clear();
+		y.clear();
+		z.clear();
+	}
+
+	void push_back(const glm::vec3& v) {
+		x.push_back(v.x);
+		y.push_back(v.y);
+		z.push_back(v.z);
+	}
+
+	//count vectors given as three separate arrays, one copy per array
+	void append(const float* px, const float* py, const float* pz, size_t count) {
+		x.insert(x.end(), px, px + count);
+		y.insert(y.end(), py, py + count);
+		z.insert(z.end(), pz, pz + count);
+	}
+
+	glm::vec3 get(size_t i) const { return glm::vec3(x[i], y[i], z[i]); }
+
+	void set(size_t i, const glm::vec3& v) {
+		x[i] = v.x;
+		y[i] = v.y;
+		z[i] = v.z;
+	}
+};
+
+
+namespace kernels {
+
+	enum class SimdLevel {
+		SCALAR,
+		SSE,
+		AVX2
+	};
+
+	//raw lanes, so a kernel can run on a slice of a batch
+	struct ConstLanes {
+		const float* x;
+		const float* y;
+		const float* z;
+	};
+
+	struct Lanes {
+		float* x;
+		float* y;
+		float* z;
+
+		operator ConstLanes() const { return ConstLanes{ x, y, z }; }
+	};
+
+	//FAST sums in whatever order the SIMD width suggests, so the last bits depend on the cpu.
+	//DETERMINISTIC gives the same bits everywhere: every kernel uses the same 8 Kahan-compensated lanes
+	//(element i goes to lane i % 8) over fixed blocks, and the blocks are added up in a fixed pairwise tree.
+	//Only holds without -ffast-math / fp contraction, which would reorder or fuse the compensation away.
+	enum class ReductionMode {
+		FAST,
+		DETERMINISTIC
+	};
+
+	const size_t REDUCE_LANES = 8;
+	const size_t REDUCE_BLOCK = 4096; //vectors per block, a multiple of REDUCE_LANES
+
+	inline ConstLanes lanes(const VectorArrays& v, size_t offset = 0) { return ConstLanes{ v.x.data() + offset, v.y.data() + offset, v.z.data() + offset }; }
+	inline Lanes lanes(VectorArrays& v, size_t offset = 0) { return Lanes{ v.x.data() + offset, v.y.data() + offset, v.z.data() + offset }; }
+
+
+	inline void kahanAdd(float& sum, float& carry, float value) {
+		float y = value - carry;
+		float t = sum + y;
+		carry = (t - sum) - y;
+		sum = t;
+	}
+
+	//lane sums (minus what each lane still owes) folded as ((0+1)+(2+3))+((4+5)+(6+7))
+	inline float combineLanes(const float* sums, const float* carries) {
+		float l[REDUCE_LANES];
+		for (size_t j = 0; j < REDUCE_LANES; ++j) {
+			l[j] = sums[j] - carries[j];
+		}
+		return ((l[0] + l[1]) + (l[2] + l[3])) + ((l[4] + l[5]) + (l[6] + l[7]));
+	}
+
+	//finishes elements [i, n) on the scalar lanes, i must be a multiple of REDUCE_LANES
+	inline float finishLanes(const float* v, size_t i, size_t n, float* sums, float* carries) {
+		for (; i < n; ++i) {
+			kahanAdd(sums[i % REDUCE_LANES], carries[i % REDUCE_LANES], v[i]);
+		}
+		return combineLanes(sums, carries);
+	}
+
+
+	// ============================ SCALAR ============================
+	namespace scalar {
+
+		inline glm::vec3 sum(ConstLanes a, size_t n) {
+			glm::vec3 total(0.0f);
+			for (size_t i = 0; i < n; ++i) {
+				total.x += a.x[i];
+				total.y += a.y[i];
+				total.z += a.z[i];
+			}
+			return total;
+		}
+
+		inline float sumCompensated(const float* v, size_t n) {
+			float sums[REDUCE_LANES] = {};
+			float carries[REDUCE_LANES] = {};
+			return finishLanes(v, 0, n, sums, carries);
+		}
+
+		inline glm::vec3 sumCompensated(ConstLanes a, size_t n) {
+			return glm::vec3(sumCompensated(a.x, n), sumCompensated(a.y, n), sumCompensated(a.z, n));
+		}
+
+		inline void add(ConstLanes a, ConstLanes b, Lanes out, size_t n) {
+			for (size_t i = 0; i < n; ++i) {
+				out.x[i] = a.x[i] + b.x[i];
+				out.y[i] = a.y[i] + b.y[i];
+				out.z[i] = a.z[i] + b.z[i];
+			}
+		}
+
+		inline void subtract(ConstLanes a, ConstLanes b, Lanes out, size_t n) {
+			for (size_t i = 0; i < n; ++i) {
+				out.x[i] = a.x[i] - b.x[i];
+				out.y[i] = a.y[i] - b.y[i];
+				out.z[i] = a.z[i] - b.z[i];
+			}
+		}
+
+		inline void scale(ConstLanes a, float s, Lanes out, size_t n) {
+			for (size_t i = 0; i < n; ++i) {
+				out.x[i] = a.x[i] * s;
+				out.y[i] = a.y[i] * s;
+				out.z[i] = a.z[i] * s;
+			}
+		}
+
+		inline void dot(ConstLanes a, ConstLanes b, float* out, size_t n) {
+			for (size_t i = 0; i < n; ++i) {
+				out[i] = a.x[i] * b.x[i] + a.y[i] * b.y[i] + a.z[i] * b.z[i];
+			}
+		}
+
+		//reads everything before writing, so out may alias a or b
+		inline void cross(ConstLanes a, ConstLanes b, Lanes out, size_t n) {
+			for (size_t i = 0; i < n; ++i) {
+				float x = a.y[i] * b.z[i] - a.z[i] * b.y[i];
+				float y = a.z[i] * b.x[i] - a.x[i] * b.z[i];
+				float z = a.x[i] * b.y[i] - a.y[i] * b.x[i];
+				out.x[i] = x;
+				out.y[i] = y;
+				out.z[i] = z;
+			}
+		}
+
+		//out[i] = m * (a[i], 1), only the affine part of m (the bottom row is taken as 0 0 0 1), out may alias a
+		//summed in the same order as the SIMD versions
+		inline void transform(const glm::mat4& m, ConstLanes a, Lanes out, size_t n) {
+			for (size_t i = 0; i < n; ++i) {
+				float x = a.x[i], y = a.y[i], z = a.z[i];
+				out.x[i] = (m[0][0] * x + m[1][0] * y) + (m[2][0] * z + m[3][0]);
+				out.y[i] = (m[0][1] * x + m[1][1] * y) + (m[2][1] * z + m[3][1]);
+				out.z[i] = (m[0][2] * x + m[1][2] * y) + (m[2][2] * z + m[3][2]);
+			}
+		}
+	}
+
+
+#ifdef VECTOR_KERNELS_X86
+	// ============================ SSE (4 wide) ============================
+	namespace sse {
+
+		KERNEL_SSE inline float horizontalSum(__m128 v) {
+			__m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+			__m128 sums = _mm_add_ps(v, shuffled);
+			shuffled = _mm_movehl_ps(shuffled, sums);
+			return _mm_cvtss_f32(_mm_add_ss(sums, shuffled));
+		}
+
+		KERNEL_SSE inline glm::vec3 sum(ConstLanes a, size_t n) {
+			__m128 sx = _mm_setzero_ps(), sy = _mm_setzero_ps(), sz = _mm_setzero_ps();
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				sx = _mm_add_ps(sx, _mm_loadu_ps(a.x + i));
+				sy = _mm_add_ps(sy, _mm_loadu_ps(a.y + i));
+				sz = _mm_add_ps(sz, _mm_loadu_ps(a.z + i));
+			}
+			glm::vec3 total(horizontalSum(sx), horizontalSum(sy), horizontalSum(sz));
+			return total + scalar::sum(ConstLanes{ a.x + i, a.y + i, a.z + i }, n - i);
+		}
+
+		KERNEL_SSE inline void kahanAdd(__m128& sum, __m128& carry, __m128 value) {
+			__m128 y = _mm_sub_ps(value, carry);
+			__m128 t = _mm_add_ps(sum, y);
+			carry = _mm_sub_ps(_mm_sub_ps(t, sum), y);
+			sum = t;
+		}
+
+		//lanes 0-3 and 4-7 in two registers
+		KERNEL_SSE inline float sumCompensated(const float* v, size_t n) {
+			__m128 sumLow = _mm_setzero_ps(), sumHigh = _mm_setzero_ps();
+			__m128 carryLow = _mm_setzero_ps(), carryHigh = _mm_setzero_ps();
+			size_t i = 0;
+			for (; i + REDUCE_LANES <= n; i += REDUCE_LANES) {
+				kahanAdd(sumLow, carryLow, _mm_loadu_ps(v + i));
+				kahanAdd(sumHigh, carryHigh, _mm_loadu_ps(v + i + 4));
+			}
+			float sums[REDUCE_LANES];
+			float carries[REDUCE_LANES];
+			_mm_storeu_ps(sums, sumLow);
+			_mm_storeu_ps(sums + 4, sumHigh);
+			_mm_storeu_ps(carries, carryLow);
+			_mm_storeu_ps(carries + 4, carryHigh);
+			return finishLanes(v, i, n, sums, carries);
+		}
+
+		KERNEL_SSE inline glm::vec3 sumCompensated(ConstLanes a, size_t n) {
+			return glm::vec3(sumCompensated(a.x, n), sumCompensated(a.y, n), sumCompensated(a.z, n));
+		}
+
+		KERNEL_SSE inline void add(ConstLanes a, ConstLanes b, Lanes out, size_t n) {
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				_mm_storeu_ps(out.x + i, _mm_add_ps(_mm_loadu_ps(a.x + i), _mm_loadu_ps(b.x + i)));
+				_mm_storeu_ps(out.y + i, _mm_add_ps(_mm_loadu_ps(a.y + i), _mm_loadu_ps(b.y + i)));
+				_mm_storeu_ps(out.z + i, _mm_add_ps(_mm_loadu_ps(a.z + i), _mm_loadu_ps(b.z + i)));
+			}
+			scalar::add(ConstLanes{ a.x + i, a.y + i, a.z + i }, ConstLanes{ b.x + i, b.y + i, b.z + i }, Lanes{ out.x + i, out.y + i, out.z + i }, n - i);
+		}
+
+		KERNEL_SSE inline void subtract(ConstLanes a, ConstLanes b, Lanes out, size_t n) {
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				_mm_storeu_ps(out.x + i, _mm_sub_ps(_mm_loadu_ps(a.x + i), _mm_loadu_ps(b.x + i)));
+				_mm_storeu_ps(out.y + i, _mm_sub_ps(_mm_loadu_ps(a.y + i), _mm_loadu_ps(b.y + i)));
+				_mm_storeu_ps(out.z + i, _mm_sub_ps(_mm_loadu_ps(a.z + i), _mm_loadu_ps(b.z + i)));
+			}
+			scalar::subtract(ConstLanes{ a.x + i, a.y + i, a.z + i }, ConstLanes{ b.x + i, b.y + i, b.z + i }, Lanes{ out.x + i, out.y + i, out.z + i }, n - i);
+		}
+
+		KERNEL_SSE inline void scale(ConstLanes a, float s, Lanes out, size_t n) {
+			__m128 factor = _mm_set1_ps(s);
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				_mm_storeu_ps(out.x + i, _mm_mul_ps(_mm_loadu_ps(a.x + i), factor));
+				_mm_storeu_ps(out.y + i, _mm_mul_ps(_mm_loadu_ps(a.y + i), factor));
+				_mm_storeu_ps(out.z + i, _mm_mul_ps(_mm_loadu_ps(a.z + i), factor));
+			}
+			scalar::scale(ConstLanes{ a.x + i, a.y + i, a.z + i }, s, Lanes{ out.x + i, out.y + i, out.z + i }, n - i);
+		}
+
+		KERNEL_SSE inline void dot(ConstLanes a, ConstLanes b, float* out, size_t n) {
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				__m128 d = _mm_mul_ps(_mm_loadu_ps(a.x + i), _mm_loadu_ps(b.x + i));
+				d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(a.y + i), _mm_loadu_ps(b.y + i)));
+				d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(a.z + i), _mm_loadu_ps(b.z + i)));
+				_mm_storeu_ps(out + i, d);
+			}
+			scalar::dot(ConstLanes{ a.x + i, a.y + i, a.z + i }, ConstLanes{ b.x + i, b.y + i, b.z + i }, out + i, n - i);
+		}
+
+		KERNEL_SSE inline void cross(ConstLanes a, ConstLanes b, Lanes out, size_t n) {
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				__m128 ax = _mm_loadu_ps(a.x + i), ay = _mm_loadu_ps(a.y + i), az = _mm_loadu_ps(a.z + i);
+				__m128 bx = _mm_loadu_ps(b.x + i), by = _mm_loadu_ps(b.y + i), bz = _mm_loadu_ps(b.z + i);
+				_mm_storeu_ps(out.x + i, _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by)));
+				_mm_storeu_ps(out.y + i, _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz)));
+				_mm_storeu_ps(out.z + i, _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx)));
+			}
+			scalar::cross(ConstLanes{ a.x + i, a.y + i, a.z + i }, ConstLanes{ b.x + i, b.y + i, b.z + i }, Lanes{ out.x + i, out.y + i, out.z + i }, n - i);
+		}
+
+		KERNEL_SSE inline void transform(const glm::mat4& m, ConstLanes a, Lanes out, size_t n) {
+			//every coefficient broadcast once, then 4 vectors per step
+			__m128 c[4][3];
+			for (int col = 0; col < 4; ++col) {
+				for (int row = 0; row < 3; ++row) {
+					c[col][row] = _mm_set1_ps(m[col][row]);
+				}
+			}
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				__m128 x = _mm_loadu_ps(a.x + i), y = _mm_loadu_ps(a.y + i), z = _mm_loadu_ps(a.z + i);
+				for (int row = 0; row < 3; ++row) {
+					__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c[0][row], x), _mm_mul_ps(c[1][row], y)), _mm_add_ps(_mm_mul_ps(c[2][row], z), c[3][row]));
+					_mm_storeu_ps((row == 0 ? out.x : row == 1 ? out.y : out.z) + i, r);
+				}
+			}
+			scalar::transform(m, ConstLanes{ a.x + i, a.y + i, a.z + i }, Lanes{ out.x + i, out.y + i, out.z + i }, n - i);
+		}
+	}
+
+
+	// ============================ AVX2 (8 wide) ============================
+	namespace avx2 {
+
+		KERNEL_AVX2 inline float horizontalSum(__m256 v) {
+			__m128 low = _mm256_castps256_ps128(v);
+			__m128 high = _mm256_extractf128_ps(v, 1);
+			return sse::horizontalSum(_mm_add_ps(low, high));
+		}
+
+		KERNEL_AVX2 inline glm::vec3 sum(ConstLanes a, size_t n) {
+			__m256 sx = _mm256_setzero_ps(), sy = _mm256_setzero_ps(), sz = _mm256_setzero_ps();
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				sx = _mm256_add_ps(sx, _mm256_loadu_ps(a.x + i));
+				sy = _mm256_add_ps(sy, _mm256_loadu_ps(a.y + i));
+				sz = _mm256_add_ps(sz, _mm256_loadu_ps(a.z + i));
+			}
+			glm::vec3 total(horizontalSum(sx), horizontalSum(sy), horizontalSum(sz));
+			return total + scalar::sum(ConstLanes{ a.x + i, a.y + i, a.z + i }, n - i);
+		}
+
+		KERNEL_AVX2 inline float sumCompensated(const float* v, size_t n) {
+			__m256 sum = _mm256_setzero_ps();
+			__m256 carry = _mm256_setzero_ps();
+			size_t i = 0;
+			for (; i + REDUCE_LANES <= n; i += REDUCE_LANES) {
+				__m256 y = _mm256_sub_ps(_mm256_loadu_ps(v + i), carry);
+				__m256 t = _mm256_add_ps(sum, y);
+				carry = _mm256_sub_ps(_mm256_sub_ps(t, sum), y);
+				sum = t;
+			}
+			float sums[REDUCE_LANES];
+			float carries[REDUCE_LANES];
+			_mm256_storeu_ps(sums, sum);
+			_mm256_storeu_ps(carries, carry);
+			return finishLanes(v, i, n, sums, carries);
+		}
+
+		KERNEL_AVX2 inline glm::vec3 sumCompensated(ConstLanes a, size_t n) {
+			return glm::vec3(sumCompensated(a.x, n), sumCompensated(a.y, n), sumCompensated(a.z, n));
+		}
+
+		KERNEL_AVX2 inline void add(ConstLanes a, ConstLanes b, Lanes out, size_t n) {
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				_mm256_storeu_ps(out.x + i, _mm256_add_ps(_mm256_loadu_ps(a.x + i), _mm256_loadu_ps(b.x + i)));
+				_mm256_storeu_ps(out.y + i, _mm256_add_ps(_mm256_loadu_ps(a.y + i), _mm256_loadu_ps(b.y + i)));
+				_mm256_storeu_ps(out.z + i, _mm256_add_ps(_mm256_loadu_ps(a.z + i), _mm256_loadu_ps(b.z + i)));
+			}
+			scalar::add(ConstLanes{ a.x + i, a.y + i, a.z + i }, ConstLanes{ b.x + i, b.y + i, b.z + i }, Lanes{ out.x + i, out.y + i, out.z + i }, n - i);
+		}
+
+		KERNEL_AVX2 inline void subtract(ConstLanes a, ConstLanes b, Lanes out, size_t n) {
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				_mm256_storeu_ps(out.x + i, _mm256_sub_ps(_mm256_loadu_ps(a.x + i), _mm256_loadu_ps(b.x + i)));
+				_mm256_storeu_ps(out.y + i, _mm256_sub_ps(_mm256_loadu_ps(a.y + i), _mm256_loadu_ps(b.y + i)));
+				_mm256_storeu_ps(out.z + i, _mm256_sub_ps(_mm256_loadu_ps(a.z + i), _mm256_loadu_ps(b.z + i)));
+			}
+			scalar::subtract(ConstLanes{ a.x + i, a.y + i, a.z + i }, ConstLanes{ b.x + i, b.y + i, b.z + i }, Lanes{ out.x + i, out.y + i, out.z + i }, n - i);
+		}
+
+		KERNEL_AVX2 inline void scale(ConstLanes a, float s, Lanes out, size_t n) {
+			__m256 factor = _mm256_set1_ps(s);
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				_mm256_storeu_ps(out.x + i, _mm256_mul_ps(_mm256_loadu_ps(a.x + i), factor));
+				_mm256_storeu_ps(out.y + i, _mm256_mul_ps(_mm256_loadu_ps(a.y + i), factor));
+				_mm256_storeu_ps(out.z + i, _mm256_mul_ps(_mm256_loadu_ps(a.z + i), factor));
+			}
+			scalar::scale(ConstLanes{ a.x + i, a.y + i, a.z + i }, s, Lanes{ out.x + i, out.y + i, out.z + i }, n - i);
+		}
+
+		KERNEL_AVX2 inline void dot(ConstLanes a, ConstLanes b, float* out, size_t n) {
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m256 d = _mm256_mul_ps(_mm256_loadu_ps(a.x + i), _mm256_loadu_ps(b.x + i));
+				d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_loadu_ps(a.y + i), _mm256_loadu_ps(b.y + i)));
+				d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_loadu_ps(a.z + i), _mm256_loadu_ps(b.z + i)));
+				_mm256_storeu_ps(out + i, d);
+			}
+			scalar::dot(ConstLanes{ a.x + i, a.y + i, a.z + i }, ConstLanes{ b.x + i, b.y + i, b.z + i }, out + i, n - i);
+		}
+
+		KERNEL_AVX2 inline void cross(ConstLanes a, ConstLanes b, Lanes out, size_t n) {
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m256 ax = _mm256_loadu_ps(a.x + i), ay = _mm256_loadu_ps(a.y + i), az = _mm256_loadu_ps(a.z + i);
+				__m256 bx = _mm256_loadu_ps(b.x + i), by = _mm256_loadu_ps(b.y + i), bz = _mm256_loadu_ps(b.z + i);
+				_mm256_storeu_ps(out.x + i, _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(az, by)));
+				_mm256_storeu_ps(out.y + i, _mm256_sub_ps(_mm256_mul_ps(az, bx), _mm256_mul_ps(ax, bz)));
+				_mm256_storeu_ps(out.z + i, _mm256_sub_ps(_mm256_mul_ps(ax, by), _mm256_mul_ps(ay, bx)));
+			}
+			scalar::cross(ConstLanes{ a.x + i, a.y + i, a.z + i }, ConstLanes{ b.x + i, b.y + i, b.z + i }, Lanes{ out.x + i, out.y + i, out.z + i }, n - i);
+		}
+
+		KERNEL_AVX2 inline void transform(const glm::mat4& m, ConstLanes a, Lanes out, size_t n) {
+			__m256 c[4][3];
+			for (int col = 0; col < 4; ++col) {
+				for (int row = 0; row < 3; ++row) {
+					c[col][row] = _mm256_set1_ps(m[col][row]);
+				}
+			}
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m256 x = _mm256_loadu_ps(a.x + i), y = _mm256_loadu_ps(a.y + i), z = _mm256_loadu_ps(a.z + i);
+				for (int row = 0; row < 3; ++row) {
+					__m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c[0][row], x), _mm256_mul_ps(c[1][row], y)), _mm256_add_ps(_mm256_mul_ps(c[2][row], z), c[3][row]));
+					_mm256_storeu_ps((row == 0 ? out.x : row == 1 ? out.y : out.z) + i, r);
+				}
+			}
+			scalar::transform(m, ConstLanes{ a.x + i, a.y + i, a.z + i }, Lanes{ out.x + i, out.y + i, out.z + i }, n - i);
+		}
+	}
+#endif
+
+
+	// ============================ DISPATCH ============================
+	struct KernelTable {
+		SimdLevel level;
+		const char* name;
+		glm::vec3 (*sum)(ConstLanes a, size_t n);
+		glm::vec3 (*sumCompensated)(ConstLanes a, size_t n); //same bits on every level
+		void (*add)(ConstLanes a, ConstLanes b, Lanes out, size_t n);
+		void (*subtract)(ConstLanes a, ConstLanes b, Lanes out, size_t n);
+		void (*scale)(ConstLanes a, float s, Lanes out, size_t n);
+		void (*dot)(ConstLanes a, ConstLanes b, float* out, size_t n);
+		void (*cross)(ConstLanes a, ConstLanes b, Lanes out, size_t n);
+		void (*transform)(const glm::mat4& m, ConstLanes a, Lanes out, size_t n);
+	};
+
+	//what this cpu (and os, for the AVX registers) can run
+	inline SimdLevel detectSimd() {
+#ifdef VECTOR_KERNELS_X86
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		bool sse2 = (info[3] & (1 << 26)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		__cpuidex(info, 7, 0);
+		bool avx2 = (info[1] & (1 << 5)) != 0;
+		if (avx2 && avx && osxsave && (_xgetbv(0) & 6) == 6) {
+			return SimdLevel::AVX2;
+		}
+		return sse2 ? SimdLevel::SSE : SimdLevel::SCALAR;
+#else
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			return SimdLevel::AVX2;
+		}
+		return __builtin_cpu_supports("sse2") ? SimdLevel::SSE : SimdLevel::SCALAR;
+#endif
+#else
+		return SimdLevel::SCALAR;
+#endif
+	}
+
+	inline KernelTable table(SimdLevel level) {
+		switch (level) {
+#ifdef VECTOR_KERNELS_X86
+		case SimdLevel::AVX2:
+			return KernelTable{ level, "avx2", avx2::sum, avx2::sumCompensated, avx2::add, avx2::subtract, avx2::scale, avx2::dot, avx2::cross, avx2::transform };
+		case SimdLevel::SSE:
+			return KernelTable{ level, "sse", sse::sum, sse::sumCompensated, sse::add, sse::subtract, sse::scale, sse::dot, sse::cross, sse::transform };
+#endif
+		default:
+			return KernelTable{ SimdLevel::SCALAR, "scalar", scalar::sum, scalar::sumCompensated, scalar::add, scalar::subtract, scalar::scale, scalar::dot, scalar::cross, scalar::transform };
+		}
+	}
+
+	//PLANE_SIMD=scalar|sse|avx2 caps the level, handy for comparing paths
+	inline SimdLevel requestedSimd() {
+		SimdLevel level = detectSimd();
+		const char* env = std::getenv("PLANE_SIMD");
+		if (env == nullptr) {
+			return level;
+		}
+		SimdLevel wanted = std::strcmp(env, "scalar") == 0 ? SimdLevel::SCALAR : std::strcmp(env, "sse") == 0 ? SimdLevel::SSE : SimdLevel::AVX2;
+		return wanted < level ? wanted : level;
+	}
+
+	//picked once, on first use
+	inline const KernelTable& active() {
+		static const KernelTable kernels = table(requestedSimd());
+		return kernels;
+	}
+
+
+	// ============================ REDUCTION ============================
+
+	//fixed split at n / 2, so the tree only depends on n
+	inline glm::vec3 pairwiseSum(const glm::vec3* partials, size_t n) {
+		if (n == 0) {
+			return glm::vec3(0.0f);
+		}
+		if (n == 1) {
+			return partials[0];
+		}
+		size_t half = n / 2;
+		return pairwiseSum(partials, half) + pairwiseSum(partials + half, n - half);
+	}
+
+	inline size_t reduceBlocks(size_t n) {
+		return (n + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+	}
+
+	//the sum of block `block`, blocks can be done in any order on any thread
+	inline glm::vec3 reduceBlock(const KernelTable& k, ConstLanes a, size_t n, size_t block) {
+		size_t begin = block * REDUCE_BLOCK;
+		size_t count = std::min(REDUCE_BLOCK, n - begin);
+		return k.sumCompensated(ConstLanes{ a.x + begin, a.y + begin, a.z + begin }, count);
+	}
+
+	inline glm::vec3 reduce(ConstLanes a, size_t n, ReductionMode mode) {
+		const KernelTable& k = active();
+		if (mode == ReductionMode::FAST) {
+			return k.sum(a, n);
+		}
+		std::vector<glm::vec3> partials(reduceBlocks(n));
+		for (size_t block = 0; block < partials.size(); ++block) {
+			partials[block] = reduceBlock(k, a, n, block);
+		}
+		return pairwiseSum(partials.data(), partials.size());
+	}
+}
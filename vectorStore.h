@@ -0,0 +1,157 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+#include "vectorKernels.h"
+
+// Handle to a vector in a VectorStore. Stays valid until that vector is removed, no matter what else is
+// added or removed; a handle to a removed vector is detected through the generation and never aliases a new one.
+struct VectorHandle {
+	uint32_t index = 0xFFFFFFFFu;
+	uint32_t generation = 0;
+
+	bool operator==(const VectorHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const VectorHandle& other) const { return !(*this == other); }
+};
+
+
+// Slot map for the user vectors.
+// Values live densely packed (SoA, ready for the SIMD kernels and for one contiguous upload), colors next to them.
+// The sparse slots map a handle to its dense position, removal moves the last vector into the hole, so add and
+// remove are O(1) and the dense arrays never have gaps.
+class VectorStore {
+public:
+	static constexpr size_t NOT_FOUND = (size_t)-1;
+
+	VectorHandle add(const glm::vec3& value, const glm::vec3& color) {
+		uint32_t slotIndex;
+		if (!m_freeSlots.empty()) {
+			slotIndex = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else {
+			slotIndex = (uint32_t)m_slots.size();
+			m_slots.push_back(Slot());
+		}
+		Slot& slot = m_slots[slotIndex];
+		slot.dense = (uint32_t)m_values.size();
+
+		m_values.push_back(value);
+		m_colors.push_back(color);
+		m_denseToSlot.push_back(slotIndex);
+		return VectorHandle{ slotIndex, slot.generation };
+	}
+
+	//bulk add for loads and imports, returns the dense index of the first new vector
+	//(they end up at [first, first + count), in order)
+	size_t append(const float* x, const float* y, const float* z, const glm::vec3* colors, size_t count) {
+		size_t first = m_values.size();
+		m_values.append(x, y, z, count);
+		m_colors.insert(m_colors.end(), colors, colors + count);
+		m_denseToSlot.reserve(first + count);
+		for (size_t i = 0; i < count; ++i) {
+			uint32_t slotIndex;
+			if (!m_freeSlots.empty()) {
+				slotIndex = m_freeSlots.back();
+				m_freeSlots.pop_back();
+			}
+			else {
+				slotIndex = (uint32_t)m_slots.size();
+				m_slots.push_back(Slot());
+			}
+			m_slots[slotIndex].dense = (uint32_t)(first + i);
+			m_denseToSlot.push_back(slotIndex);
+		}
+		return first;
+	}
+
+	//the last vector moves into the removed one's dense position, returns that position (NOT_FOUND if the handle is stale)
+	size_t remove(VectorHandle handle) {
+		size_t dense = denseIndex(handle);
+		if (dense == NOT_FOUND) {
+			return NOT_FOUND;
+		}
+		size_t last = m_values.size() - 1;
+		if (dense != last) {
+			m_values.set(dense, m_values.get(last));
+			m_colors[dense] = m_colors[last];
+			m_denseToSlot[dense] = m_denseToSlot[last];
+			m_slots[m_denseToSlot[dense]].dense = (uint32_t)dense;
+		}
+		m_values.resize(last);
+		m_colors.pop_back();
+		m_denseToSlot.pop_back();
+
+		Slot& slot = m_slots[handle.index];
+		++slot.generation;
+		m_freeSlots.push_back(handle.index);
+		return dense;
+	}
+
+	//every handle handed out so far becomes stale
+	void clear() {
+		for (uint32_t slotIndex : m_denseToSlot) {
+			++m_slots[slotIndex].generation;
+			m_freeSlots.push_back(slotIndex);
+		}
+		m_values.clear();
+		m_colors.clear();
+		m_denseToSlot.clear();
+	}
+
+
+	bool valid(VectorHandle handle) const {
+		return handle.index < m_slots.size() && m_slots[handle.index].generation == handle.generation;
+	}
+
+	size_t denseIndex(VectorHandle handle) const {
+		return valid(handle) ? m_slots[handle.index].dense : NOT_FOUND;
+	}
+
+	VectorHandle handle(size_t dense) const {
+		uint32_t slotIndex = m_denseToSlot[dense];
+		return VectorHandle{ slotIndex, m_slots[slotIndex].generation };
+	}
+
+	glm::vec3 value(VectorHandle handle) const { return m_values.get(m_slots[handle.index].dense); }
+	glm::vec3 color(VectorHandle handle) const { return m_colors[m_slots[handle.index].dense]; }
+
+	void set(VectorHandle handle, const glm::vec3& value) {
+		if (valid(handle)) {
+			m_values.set(m_slots[handle.index].dense, value);
+		}
+	}
+
+	void setColor(VectorHandle handle, const glm::vec3& color) {
+		if (valid(handle)) {
+			m_colors[m_slots[handle.index].dense] = color;
+		}
+	}
+
+
+	//dense access, i in [0, size())
+	size_t size() const { return m_values.size(); }
+	bool empty() const { return m_values.empty(); }
+	const VectorArrays& values() const { return m_values; }
+	const std::vector<glm::vec3>& colors() const { return m_colors; }
+	glm::vec3 valueAt(size_t dense) const { return m_values.get(dense); }
+	glm::vec3 colorAt(size_t dense) const { return m_colors[dense]; }
+
+
+
+private:
+	struct Slot {
+		uint32_t dense = 0;
+		uint32_t generation = 0;
+	};
+
+	std::vector<Slot> m_slots;
+	std::vector<uint32_t> m_freeSlots;
+
+	VectorArrays m_values;
+	std::vector<glm::vec3> m_colors;
+	std::vector<uint32_t> m_denseToSlot;
+};
@@ -0,0 +1,310 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "spscRing.h"
+
+// One vector update as it comes off the stream, 20 bytes little endian.
+// id is the sender's own numbering: the first time an id shows up it becomes a new vector, after that it moves it.
+struct StreamUpdate {
+	uint32_t id;
+	float x, y, z;
+	uint32_t color; //packed RGBA8 like ArrowInstance::color, 0 keeps the current one
+};
+static_assert(sizeof(StreamUpdate) == 20, "part of the stream format");
+
+
+// Live vector updates from another process, read on a background thread:
+//   plane --stream -                    stdin        (sim | plane --stream -)
+//   plane --stream /tmp/plane.fifo      a file or a FIFO (reopened when the writer goes away)
+//   plane --stream unix:/tmp/plane.sock listens on a Unix socket, one client at a time (not on Windows)
+// The stream is a sequence of frames: uint32 'PVSU' magic, uint32 count, count StreamUpdates.
+// Garbage before a magic is skipped (counted in resyncs()). Records go into a lock-free SPSC ring; when the ring
+// is full the reader stops reading, so a fast sender is slowed down by the pipe instead of eating memory.
+// The update thread drain()s a bounded batch per tick (see scene.h).
+class VectorStream {
+public:
+	static constexpr uint32_t FRAME_MAGIC = 'P' | ('V' << 8) | ('S' << 16) | ((uint32_t)'U' << 24);
+
+	explicit VectorStream(size_t ringCapacity = 1 << 20)
+		: m_ring{ ringCapacity } {
+	};
+
+	~VectorStream() {
+		stop();
+	};
+
+	VectorStream(const VectorStream&) = delete;
+	VectorStream& operator=(const VectorStream&) = delete;
+
+
+	bool start(const std::string& source) {
+		if (m_thread.joinable()) {
+			return false;
+		}
+#ifdef _WIN32
+		if (source.compare(0, 5, "unix:") == 0) {
+			std::cout << "ERROR::STREAM::NO_UNIX_SOCKETS " << source << "\n";
+			return false;
+		}
+#endif
+		m_stop = false;
+		m_running = true;
+		m_thread = std::thread(&VectorStream::run, this, source);
+		return true;
+	};
+
+	void stop() {
+		m_stop = true;
+		if (m_thread.joinable()) {
+			m_thread.join();
+		}
+	};
+
+	//update thread: up to max updates, oldest first, out holds only those afterwards
+	size_t drain(std::vector<StreamUpdate>& out, size_t max) {
+		out.clear();
+		return m_ring.pop(out, max);
+	};
+
+	bool running() const { return m_running; }
+	uint64_t received() const { return m_received; }
+	uint64_t resyncs() const { return m_resyncs; }
+	size_t queued() const { return m_ring.size(); }
+	size_t capacity() const { return m_ring.capacity(); }
+
+
+
+private:
+	SpscRing<StreamUpdate> m_ring;
+	std::thread m_thread;
+	std::atomic<bool> m_stop{ false };
+	std::atomic<bool> m_running{ false };
+	std::atomic<uint64_t> m_received{ 0 };
+	std::atomic<uint64_t> m_resyncs{ 0 };
+
+	//reader thread only: bytes that didn't make a whole header / record yet
+	std::vector<uint8_t> m_pending;
+	uint32_t m_frameLeft = 0; //records still to come in the current frame
+	std::vector<StreamUpdate> m_parsed;
+
+	static constexpr size_t READ_SIZE = 1 << 16;
+
+
+	void run(std::string source) {
+		if (source == "-") {
+			readStdin();
+		}
+#ifndef _WIN32
+		else if (source.compare(0, 5, "unix:") == 0) {
+			readSocket(source.substr(5));
+		}
+#endif
+		else {
+			readPath(source);
+		}
+		m_running = false;
+	};
+
+
+	//frames -> records, keeps whatever is left over for the next call
+	void consume(const uint8_t* data, size_t size) {
+		m_pending.insert(m_pending.end(), data, data + size);
+		size_t offset = 0;
+		m_parsed.clear();
+		while (true) {
+			size_t left = m_pending.size() - offset;
+			if (m_frameLeft == 0) {
+				if (left < 8) {
+					break;
+				}
+				uint32_t magic;
+				std::memcpy(&magic, m_pending.data() + offset, 4);
+				if (magic != FRAME_MAGIC) {
+					++offset;
+					++m_resyncs;
+					continue;
+				}
+				std::memcpy(&m_frameLeft, m_pending.data() + offset + 4, 4);
+				offset += 8;
+				continue;
+			}
+			size_t records = std::min<size_t>(m_frameLeft, left / sizeof(StreamUpdate));
+			if (records == 0) {
+				break;
+			}
+			size_t first = m_parsed.size();
+			m_parsed.resize(first + records);
+			std::memcpy(m_parsed.data() + first, m_pending.data() + offset, records * sizeof(StreamUpdate));
+			offset += records * sizeof(StreamUpdate);
+			m_frameLeft -= (uint32_t)records;
+		}
+		m_pending.erase(m_pending.begin(), m_pending.begin() + offset);
+		publish(m_parsed.data(), m_parsed.size());
+	};
+
+	//waits for room while the update thread catches up
+	void publish(const StreamUpdate* updates, size_t count) {
+		while (count > 0 && !m_stop) {
+			size_t pushed = m_ring.push(updates, count);
+			updates += pushed;
+			count -= pushed;
+			m_received += pushed;
+			if (count > 0) {
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+			}
+		}
+	};
+
+	void resetParser() {
+		m_pending.clear();
+		m_frameLeft = 0;
+	};
+
+
+#ifdef _WIN32
+	//pipes are polled with PeekNamedPipe so stop() never waits on a blocked read
+	bool readHandle(HANDLE handle) {
+		std::vector<uint8_t> buffer(READ_SIZE);
+		bool pipe = GetFileType(handle) == FILE_TYPE_PIPE;
+		while (!m_stop) {
+			if (pipe) {
+				DWORD available = 0;
+				if (!PeekNamedPipe(handle, NULL, 0, NULL, &available, NULL)) {
+					return true; //writer closed
+				}
+				if (available == 0) {
+					Sleep(1);
+					continue;
+				}
+			}
+			DWORD read = 0;
+			if (!ReadFile(handle, buffer.data(), (DWORD)buffer.size(), &read, NULL) || read == 0) {
+				return true;
+			}
+			consume(buffer.data(), read);
+		}
+		return false;
+	};
+
+	void readStdin() {
+		readHandle(GetStdHandle(STD_INPUT_HANDLE));
+	};
+
+	void readPath(const std::string& path) {
+		HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+		if (handle == INVALID_HANDLE_VALUE) {
+			std::cout << "ERROR::STREAM::NOT_OPENED " << path << "\n";
+			return;
+		}
+		readHandle(handle);
+		CloseHandle(handle);
+	};
+#else
+	//false once stop() was called, true at end of file / when the other side hung up
+	bool readFd(int fd) {
+		std::vector<uint8_t> buffer(READ_SIZE);
+		while (!m_stop) {
+			pollfd wait{ fd, POLLIN, 0 };
+			int ready = poll(&wait, 1, 50);
+			if (ready < 0) {
+				return true;
+			}
+			if (ready == 0) {
+				continue;
+			}
+			ssize_t got = read(fd, buffer.data(), buffer.size());
+			if (got <= 0) {
+				return true;
+			}
+			consume(buffer.data(), (size_t)got);
+		}
+		return false;
+	};
+
+	void readStdin() {
+		readFd(STDIN_FILENO);
+	};
+
+	void readPath(const std::string& path) {
+		while (!m_stop) {
+			//O_NONBLOCK so opening a FIFO doesn't wait for a writer, reads go back to blocking (through poll)
+			int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK);
+			if (fd < 0) {
+				std::cout << "ERROR::STREAM::NOT_OPENED " << path << "\n";
+				return;
+			}
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+			struct stat info;
+			bool fifo = fstat(fd, &info) == 0 && S_ISFIFO(info.st_mode);
+			resetParser();
+			bool finished = readFd(fd);
+			close(fd);
+			if (!fifo || !finished) {
+				return;
+			}
+			//the writer went away, wait for the next one
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+	};
+
+	void readSocket(const std::string& path) {
+		int server = socket(AF_UNIX, SOCK_STREAM, 0);
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		if (server < 0 || path.size() >= sizeof(address.sun_path)) {
+			std::cout << "ERROR::STREAM::SOCKET " << path << "\n";
+			if (server >= 0) {
+				close(server);
+			}
+			return;
+		}
+		std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+		unlink(path.c_str());
+		if (bind(server, (sockaddr*)&address, sizeof(address)) != 0 || listen(server, 1) != 0) {
+			std::cout << "ERROR::STREAM::SOCKET_NOT_BOUND " << path << "\n";
+			close(server);
+			return;
+		}
+		while (!m_stop) {
+			pollfd wait{ server, POLLIN, 0 };
+			if (poll(&wait, 1, 50) <= 0) {
+				continue;
+			}
+			int client = accept(server, NULL, NULL);
+			if (client < 0) {
+				continue;
+			}
+			resetParser();
+			readFd(client);
+			close(client);
+		}
+		close(server);
+		unlink(path.c_str());
+	};
+#endif
+};
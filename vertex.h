@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Interleaved vertex layout shared by the grid and the vector lines.
+// Color is packed RGBA8 (normalized in the shader), so a vertex is 16 bytes instead of two vec3 streams (24 bytes).
+struct Vertex {
+	glm::vec3 position;
+	uint32_t color;
+
+	//describes this layout to the currently bound VAO / GL_ARRAY_BUFFER
+	static void setupAttributes() {
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+		glEnableVertexAttribArray(0);
+
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+		glEnableVertexAttribArray(1);
+	};
+};
+
+
+//packs a 0..1 color into RGBA8, red in the lowest byte so it lands in .r on little endian
+inline uint32_t packColor(const glm::vec3& color, float alpha = 1.0f) {
+	auto toByte = [](float c) -> uint32_t {
+		c = c < 0.0f ? 0.0f : (c > 1.0f ? 1.0f : c);
+		return (uint32_t)(c * 255.0f + 0.5f);
+	};
+	return toByte(color.x) | (toByte(color.y) << 8) | (toByte(color.z) << 16) | (toByte(alpha) << 24);
+}
+
+inline glm::vec3 unpackColor(uint32_t color) {
+	return glm::vec3((color & 0xFF) / 255.0f, ((color >> 8) & 0xFF) / 255.0f, ((color >> 16) & 0xFF) / 255.0f);
+}